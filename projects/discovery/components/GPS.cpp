@@ -237,8 +237,9 @@ const char GPSParser::toHex[] = { '0','1','2','3','4','5','6','7','8','9','A','B
 // ----------------------------------------------------------------
 
 GPSSerial::GPSSerial(PinName tx /*= GPSTXD*/, PinName rx /*= GPSRXD*/, int baudrate /*= GPSBAUD*/,
-                    int rxSize /*= 256*/, int txSize /*= 128*/) :
-                    SerialPipe(tx, rx, rxSize, txSize)
+                    int rxSize /*= 256*/, int txSize /*= 128*/,
+                    char* rxBuf /*= NULL*/, char* txBuf /*= NULL*/) :
+                    SerialPipe(tx, rx, rxSize, txSize, rxBuf, txBuf)
 {
   baud(baudrate);
 #ifdef TARGET_UBLOX_C027
@@ -285,9 +286,10 @@ int GPSSerial::_send(const void* buf, int len)
 // ----------------------------------------------------------------
 
 GPSI2C::GPSI2C(PinName sda /*= GPSSDA*/, PinName scl /*= GPSSCL*/,
-              unsigned char i2cAdr /*=GPSADR*/, int rxSize /*= 256*/) :
+              unsigned char i2cAdr /*=GPSADR*/, int rxSize /*= 256*/,
+              char* rxBuf /*= NULL*/) :
               I2C(sda,scl),
-              _pipe(rxSize),
+              _pipe(rxSize, rxBuf),
               _i2cAdr(i2cAdr)
 {
   frequency(100000);
@@ -320,12 +322,17 @@ bool GPSI2C::init(PinName pn)
 
 int GPSI2C::getMessage(char* buf, int len)
 {
-  // fill the pipe
-  int sz = _pipe.free();
-  if (sz)
-    sz = _get(buf, sz);
-  if (sz)
-    _pipe.put(buf, sz);
+  // fill the pipe, read directly into the free space
+  Pipe<char>::Span s[2];
+  _pipe.writeSpans(s);
+  for (int i = 0; (i < 2) && s[i].n; i ++)
+  {
+    int sz = _get(s[i].p, s[i].n);
+    if (sz)
+      _pipe.writeCommit(sz);
+    if (sz < s[i].n)
+      break;
+  }
   // now parse it
   return _getMessage(&_pipe, buf, len);
 }
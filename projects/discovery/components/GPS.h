@@ -173,12 +173,16 @@ public:
    *  \param baudrate the baudrate of the gps use 9600
    *  \param rxSize the size of the serial rx buffer
    *  \param txSize the size of the serial tx buffer
+   *  \param rxBuf optional serial rx buffer, allocated if NULL
+   *  \param txBuf optional serial tx buffer, allocated if NULL
    */
   GPSSerial(PinName tx    GPS_IF( = GPSTXD, /* = D8 */), // resistor on shield not populated
   PinName rx    GPS_IF( = GPSRXD, /* = D9 */), // resistor on shield not populated
   int baudrate  GPS_IF( = GPSBAUD, = 9600 ),
   int rxSize    = 256 ,
-  int txSize    = 128 );
+  int txSize    = 128 ,
+  char* rxBuf   = NULL,
+  char* txBuf   = NULL);
 
   //! Destructor
   virtual ~GPSSerial(void);
@@ -213,11 +217,13 @@ public:
    *  \param scl is the I2C SCL pin (CPU to GPS)
    *  \param adr the I2C address of the GPS set to (66<<1)
    *  \param rxSize the size of the serial rx buffer
+   *  \param rxBuf optional rx buffer, allocated if NULL
    */
   GPSI2C(PinName sda          GPS_IF( = GPSSDA, = D14 ),
   PinName scl          GPS_IF( = GPSSCL, = D15 ),
   unsigned char i2cAdr GPS_IF( = GPSADR, = (66<<1) ),
-  int rxSize           = 256 );
+  int rxSize           = 256 ,
+  char* rxBuf          = NULL);
   //! Destructor
   virtual ~GPSI2C(void);
 
@@ -261,6 +267,13 @@ public:
   virtual int sendUbx(unsigned char cls, unsigned char id,
   const void* buf = NULL, int len = 0);
 
+  /** Get the statistics of the rx pipe
+   *  \param st the statistics
+   *  \param reset set to true to restart the counters
+   *  \return true if successful, false if compiled without PIPE_STATS
+   */
+  bool stats(PipeStats* st, bool reset = false) { return _pipe.stats(st, reset); }
+
 protected:
   /** check if the port is writeable (like SerialPipe)
    *  \return true if writeable
@@ -292,3 +305,39 @@ protected:
   static const char REGLEN;   //!< the length i2c register address
   static const char REGSTREAM;//!< the stream i2c register address
 };
+
+/** gps class which uses a serial port with statically sized buffers.
+ *  The buffers are part of the object, so no heap is used.
+ *  \tparam RXSIZE the size of the serial rx buffer (power of two)
+ *  \tparam TXSIZE the size of the serial tx buffer (power of two)
+ */
+template <int RXSIZE = 256, int TXSIZE = 128>
+class GPSSerialStatic : private SerialPipeStorage<RXSIZE, TXSIZE>, public GPSSerial
+{
+public:
+  /** Constructor, see #GPSSerial
+   */
+  GPSSerialStatic(PinName tx    GPS_IF( = GPSTXD, /* = D8 */),
+                  PinName rx    GPS_IF( = GPSRXD, /* = D9 */),
+                  int baudrate  GPS_IF( = GPSBAUD, = 9600 )) :
+    GPSSerial(tx, rx, baudrate, RXSIZE, TXSIZE,
+              this->_rxStorage, this->_txStorage)
+  { }
+};
+
+/** gps class which uses a i2c with a statically sized buffer.
+ *  The buffer is part of the object, so no heap is used.
+ *  \tparam RXSIZE the size of the rx buffer (power of two)
+ */
+template <int RXSIZE = 256>
+class GPSI2CStatic : private PipeStorage<char, RXSIZE>, public GPSI2C
+{
+public:
+  /** Constructor, see #GPSI2C
+   */
+  GPSI2CStatic(PinName sda          GPS_IF( = GPSSDA, = D14 ),
+               PinName scl          GPS_IF( = GPSSCL, = D15 ),
+               unsigned char i2cAdr GPS_IF( = GPSADR, = (66<<1) )) :
+    GPSI2C(sda, scl, i2cAdr, RXSIZE, this->_storage)
+  { }
+};
@@ -1,4 +1,5 @@
 #include "mbed.h"
+#include "us_ticker_api.h"
 #include "MDM.h"
 #include "MDMAPN.h"
 
@@ -14,6 +15,8 @@
 #define REG_OK(r)       ((r == REG_HOME) || (r == REG_ROAMING))
 //! registration done check helper (no need to poll further)
 #define REG_DONE(r)     ((r == REG_HOME) || (r == REG_ROAMING) || (r == REG_DENIED))
+//! period in s that extends the clock, well inside the 71 minutes of the us ticker
+#define CLOCK_TICK_S    (10*60)
 //! helper to make sure that lock unlock pair is always balanced
 #define LOCK()         { lock()
 //! helper to make sure that lock unlock pair is always balanced
@@ -96,18 +99,48 @@ MDMParser::MDMParser(void)
   memset(&_net, 0, sizeof(_net));
   _net.lac = 0xFFFF;
   _net.ci  = 0xFFFFFFFF;
+  _netValid = false;
+  _netTime  = 0;
   _ip      = NOIP;
   _init    = false;
+  _warm    = false;
   memset(_sockets, 0, sizeof(_sockets));
   for (int socket = 0; socket < NUMSOCKETS; socket++) {
     _sockets[socket].handle = SOCKET_ERROR;
   }
+  _direct  = SOCKET_ERROR;
+  memset(_urc, 0, sizeof(_urc));
+  memset(_cmd, 0, sizeof(_cmd));
+  for (int i = 0; i < CMD_QUEUE; i ++)
+    _cmd[i].handle = SOCKET_ERROR;
+  _cmdW = _cmdR = 0;
+  memset(&_cmdStats, 0, sizeof(_cmdStats));
+  memset(_dns, 0, sizeof(_dns));
+  memset(&_dnsStats, 0, sizeof(_dnsStats));
+  _clockMs = 0;
+  _clockRest = 0;
+  _clockLast = us_ticker_read();
+  _clockTicker.attach(this, &MDMParser::_clockTick, CLOCK_TICK_S);
 #ifdef MDM_DEBUG
   _debugLevel = 1;
   _debugTime.start();
 #endif
 }
 
+uint64_t MDMParser::_clock(void)
+{
+  // the ticker interrupt calls this too, so the lap is never missed
+  __disable_irq();
+  uint32_t now = us_ticker_read();
+  uint32_t us = (uint32_t)(now - _clockLast) + _clockRest;
+  _clockLast = now;
+  _clockMs += us / 1000;
+  _clockRest = us % 1000;
+  uint64_t ms = _clockMs;
+  __enable_irq();
+  return ms;
+}
+
 int MDMParser::send(const char* buf, int len)
 {
 #ifdef MDM_DEBUG
@@ -120,6 +153,9 @@ int MDMParser::send(const char* buf, int len)
 }
 
 int MDMParser::sendFormated(const char* format, ...) {
+  // in direct link mode the command would be sent as data
+  if (_direct != SOCKET_ERROR)
+    return 0;
   char buf[MAX_SIZE];
   va_list args;
   va_start(args, format);
@@ -132,6 +168,9 @@ int MDMParser::waitFinalResp(_CALLBACKPTR cb /* = NULL*/,
                              void* param /* = NULL*/,
                              int timeout_ms /*= 5000*/)
 {
+  // in direct link mode the received data is not parsed
+  if (_direct != SOCKET_ERROR)
+    return WAIT;
   char buf[MAX_SIZE + 64 /* add some more space for framing */];
   Timer timer;
   timer.start();
@@ -157,92 +196,8 @@ int MDMParser::waitFinalResp(_CALLBACKPTR cb /* = NULL*/,
     {
       int type = TYPE(ret);
       // handle unsolicited commands here
-      if (type == TYPE_PLUS) {
-        const char* cmd = buf+3;
-        int a, b, c, d, r;
-        char s[32];
-
-        // SMS Command ---------------------------------
-        // +CNMI: <mem>,<index>
-        if (sscanf(cmd, "CMTI: \"%*[^\"]\",%d", &a) == 1) {
-          TRACE("New SMS at index %d\r\n", a);
-        // Socket Specific Command ---------------------------------
-        // +UUSORD: <socket>,<length>
-        } else if ((sscanf(cmd, "UUSORD: %d,%d", &a, &b) == 2)) {
-          int socket = _findSocket(a);
-          TRACE("Socket %d: handle %d has %d bytes pending\r\n", socket, a, b);
-          if (socket != SOCKET_ERROR)
-            _sockets[socket].pending = b;
-        // +UUSORF: <socket>,<length>
-        } else if ((sscanf(cmd, "UUSORF: %d,%d", &a, &b) == 2)) {
-          int socket = _findSocket(a);
-          TRACE("Socket %d: handle %d has %d bytes pending\r\n", socket, a, b);
-          if (socket != SOCKET_ERROR)
-            _sockets[socket].pending = b;
-        // +UUSOCL: <socket>
-        } else if ((sscanf(cmd, "UUSOCL: %d", &a) == 1)) {
-          int socket = _findSocket(a);
-          TRACE("Socket %d: handle %d closed by remote host\r\n", socket, a);
-          if ((socket != SOCKET_ERROR) && _sockets[socket].connected)
-            _sockets[socket].connected = false;
-        }
-        if (_dev.dev == DEV_LISA_C200) {
-          // CDMA Specific -------------------------------------------
-          // +CREG: <n><SID>,<NID>,<stat>
-          if (sscanf(cmd, "CREG: %*d,%d,%d,%d",&a,&b,&c) == 3) {
-            // _net.sid = a;
-            // _net.nid = b;
-            if      (c == 0) _net.csd = REG_NONE;     // not registered, home network
-            else if (c == 1) _net.csd = REG_HOME;     // registered, home network
-            else if (c == 2) _net.csd = REG_NONE;     // not registered, but MT is currently searching a new operator to register to
-            else if (c == 3) _net.csd = REG_DENIED;   // registration denied
-            else if (c == 5) _net.csd = REG_ROAMING;  // registered, roaming
-            _net.psd = _net.csd; // fake PSD registration (CDMA is always registered)
-            _net.act = ACT_CDMA;
-            // +CSS: <mode>[,<format>,<oper>[,<AcT>]]
-          } else if (sscanf(cmd, "CSS %*c,%2s,%*d",s) == 1) {
-            //_net.reg = (strcmp("Z", s) == 0) ? REG_UNKNOWN : REG_HOME;
-          }
-        } else {
-          // GSM/UMTS Specific -------------------------------------------
-          // +UUPSDD: <profile_id>
-          if (sscanf(cmd, "UUPSDD: %d",&a) == 1) {
-            if (*PROFILE == a) _ip = NOIP;
-          } else {
-            // +CREG|CGREG: <n>,<stat>[,<lac>,<ci>[,AcT[,<rac>]]] // reply to AT+CREG|AT+CGREG
-            // +CREG|CGREG: <stat>[,<lac>,<ci>[,AcT[,<rac>]]]     // URC
-            b = 0xFFFF; c = 0xFFFFFFFF; d = -1;
-            r = sscanf(cmd, "%s %*d,%d,\"%X\",\"%X\",%d",s,&a,&b,&c,&d);
-            if (r <= 1)
-              r = sscanf(cmd, "%s %d,\"%X\",\"%X\",%d",s,&a,&b,&c,&d);
-            if (r >= 2) {
-              Reg *reg = !strcmp(s, "CREG:")  ? &_net.csd :
-                         !strcmp(s, "CGREG:") ? &_net.psd : NULL;
-              if (reg) {
-                // network status
-                if      (a == 0) *reg = REG_NONE;     // 0: not registered, home network
-                else if (a == 1) *reg = REG_HOME;     // 1: registered, home network
-                else if (a == 2) *reg = REG_NONE;     // 2: not registered, but MT is currently searching a new operator to register to
-                else if (a == 3) *reg = REG_DENIED;   // 3: registration denied
-                else if (a == 4) *reg = REG_UNKNOWN;  // 4: unknown
-                else if (a == 5) *reg = REG_ROAMING;  // 5: registered, roaming
-                if ((r >= 3) && (b != 0xFFFF))                _net.lac = b; // location area code
-                if ((r >= 4) && ((unsigned)c != 0xFFFFFFFF))  _net.ci  = c; // cell ID
-                // access technology
-                if (r >= 5) {
-                  if      (d == 0) _net.act = ACT_GSM;      // 0: GSM
-                  else if (d == 1) _net.act = ACT_GSM;      // 1: GSM COMPACT
-                  else if (d == 2) _net.act = ACT_UTRAN;    // 2: UTRAN
-                  else if (d == 3) _net.act = ACT_EDGE;     // 3: GSM with EDGE availability
-                  else if (d == 4) _net.act = ACT_UTRAN;    // 4: UTRAN with HSDPA availability
-                  else if (d == 5) _net.act = ACT_UTRAN;    // 5: UTRAN with HSUPA availability
-                  else if (d == 6) _net.act = ACT_UTRAN;    // 6: UTRAN with HSDPA and HSUPA availability
-                }
-              }
-            }
-          }
-        }
-      }
+      if (type == TYPE_PLUS)
+        _handleUrc(buf, LENGTH(ret));
       if (cb) {
         int len = LENGTH(ret);
         int ret = cb(type, buf, len, param);
@@ -256,13 +211,340 @@ int MDMParser::waitFinalResp(_CALLBACKPTR cb /* = NULL*/,
       if (type == TYPE_PROMPT)
         return RESP_PROMPT;
     }
-    // relax a bit
-    wait_ms(10);
+    // sleep until more data arrives, but not beyond the timeout
+    else if (timeout_ms == 0)
+      break;
+    else if (!TIMEOUT(timer, timeout_ms))
+      waitRx((timeout_ms == TIMEOUT_BLOCKING) ? TIMEOUT_BLOCKING :
+             (timeout_ms + 1 - timer.read_ms()));
   }
   while (!TIMEOUT(timer, timeout_ms));
   return WAIT;
 }
 
+// field extractors for the urcs, cheaper than sscanf, they return the
+// position after the field or NULL if the field does not match
+static const char* _scanChar(const char* p, const char* e, char ch)
+{
+  return (p && (p < e) && (*p == ch)) ? p + 1 : NULL;
+}
+
+static const char* _scanInt(const char* p, const char* e, int* v)
+{
+  if (!p) return NULL;
+  bool neg = (p < e) && (*p == '-');
+  if (neg) p ++;
+  if ((p >= e) || (*p < '0') || (*p > '9')) return NULL;
+  int n = 0;
+  while ((p < e) && (*p >= '0') && (*p <= '9'))
+    n = n * 10 + (*p++ - '0');
+  *v = neg ? -n : n;
+  return p;
+}
+
+static const char* _scanHex(const char* p, const char* e, int* v)
+{
+  // a quoted hex number e.g. "0F2A"
+  p = _scanChar(p, e, '\"');
+  if (!p) return NULL;
+  unsigned int n = 0;
+  const char* s = p;
+  for ( ; p < e; p ++) {
+    char ch = *p;
+    if      (ch >= '0' && ch <= '9') n = (n << 4) | (ch - '0');
+    else if (ch >= 'A' && ch <= 'F') n = (n << 4) | (ch - 'A' + 10);
+    else if (ch >= 'a' && ch <= 'f') n = (n << 4) | (ch - 'a' + 10);
+    else break;
+  }
+  if (p == s) return NULL;
+  *v = (int)n;
+  return _scanChar(p, e, '\"');
+}
+
+static const char* _scanStr(const char* p, const char* e)
+{
+  // skip a quoted string
+  p = _scanChar(p, e, '\"');
+  while (p && (p < e) && (*p != '\"'))
+    p ++;
+  return _scanChar(p, e, '\"');
+}
+
+void MDMParser::_handleUrc(const char* buf, int len)
+{
+  enum { URC_CMTI, URC_UUSORD, URC_UUSORF, URC_UUSOCL, URC_UUPSDD, URC_CREG, URC_CGREG };
+  // the urcs and responses handled here, keyed by the name between '+' and ':'
+  static const struct { const char* name; int len; int urc; } lut[] = {
+    { "CMTI",   4, URC_CMTI   }, // +CMTI: <mem>,<index>
+    { "UUSORD", 6, URC_UUSORD }, // +UUSORD: <socket>,<length>
+    { "UUSORF", 6, URC_UUSORF }, // +UUSORF: <socket>,<length>
+    { "UUSOCL", 6, URC_UUSOCL }, // +UUSOCL: <socket>
+    { "UUPSDD", 6, URC_UUPSDD }, // +UUPSDD: <profile_id>
+    { "CREG",   4, URC_CREG   }, // +CREG: ...
+    { "CGREG",  5, URC_CGREG  }, // +CGREG: ...
+  };
+  const char* e = buf + len;
+  const char* n = buf + 3; // "\r\n+"
+  const char* p = n;
+  while ((p < e) && (*p != ':') && (*p != '\r'))
+    p ++;
+  int nl = p - n;
+  if (!(p = _scanChar(p, e, ':')))
+    return;
+  while ((p < e) && (*p == ' '))
+    p ++;
+  int urc = -1;
+  for (unsigned int i = 0; (urc < 0) && (i < sizeof(lut)/sizeof(*lut)); i ++) {
+    if ((lut[i].len == nl) && (lut[i].name[0] == n[0]) && !memcmp(lut[i].name, n, nl))
+      urc = lut[i].urc;
+  }
+  int a, b, c, d, r;
+  switch (urc) {
+    // SMS Command ---------------------------------
+    case URC_CMTI:
+      if (_scanInt(_scanChar(_scanStr(p, e), e, ','), e, &a))
+        TRACE("New SMS at index %d\r\n", a);
+      break;
+    // Socket Specific Command ---------------------------------
+    case URC_UUSORD:
+    case URC_UUSORF:
+      if (_scanInt(_scanChar(_scanInt(p, e, &a), e, ','), e, &b)) {
+        int socket = _findSocket(a);
+        TRACE("Socket %d: handle %d has %d bytes pending\r\n", socket, a, b);
+        if (socket != SOCKET_ERROR) {
+          _sockets[socket].pending = b;
+          pollWake();
+        }
+      }
+      break;
+    case URC_UUSOCL:
+      if (_scanInt(p, e, &a)) {
+        int socket = _findSocket(a);
+        TRACE("Socket %d: handle %d closed by remote host\r\n", socket, a);
+        if ((socket != SOCKET_ERROR) && _sockets[socket].connected) {
+          _sockets[socket].connected = false;
+          pollWake();
+        }
+      }
+      break;
+    // GSM/UMTS Specific -------------------------------------------
+    case URC_UUPSDD:
+      if ((_dev.dev != DEV_LISA_C200) && _scanInt(p, e, &a)) {
+        if (*PROFILE == a) _ip = NOIP;
+      }
+      break;
+    case URC_CREG:
+      if (_dev.dev == DEV_LISA_C200) {
+        // CDMA Specific -------------------------------------------
+        // +CREG: <n><SID>,<NID>,<stat>
+        const char* q = _scanChar(_scanInt(p, e, &d), e, ',');
+        q = _scanChar(_scanInt(q, e, &a), e, ',');
+        if (_scanInt(_scanChar(_scanInt(q, e, &b), e, ','), e, &c)) {
+          // _net.sid = a;
+          // _net.nid = b;
+          if      (c == 0) _net.csd = REG_NONE;     // not registered, home network
+          else if (c == 1) _net.csd = REG_HOME;     // registered, home network
+          else if (c == 2) _net.csd = REG_NONE;     // not registered, but MT is currently searching a new operator to register to
+          else if (c == 3) _net.csd = REG_DENIED;   // registration denied
+          else if (c == 5) _net.csd = REG_ROAMING;  // registered, roaming
+          _net.psd = _net.csd; // fake PSD registration (CDMA is always registered)
+          _net.act = ACT_CDMA;
+        }
+        break;
+      }
+      /* fall through */
+    case URC_CGREG:
+      if (_dev.dev != DEV_LISA_C200) {
+        // +CREG|CGREG: <n>,<stat>[,<lac>,<ci>[,AcT[,<rac>]]] // reply to AT+CREG|AT+CGREG
+        // +CREG|CGREG: <stat>[,<lac>,<ci>[,AcT[,<rac>]]]     // URC
+        b = 0xFFFF; c = 0xFFFFFFFF; d = -1;
+        const char* q = _scanInt(p, e, &a);
+        if (!q) break;
+        r = 1;
+        // the reply starts with two numbers
+        const char* t = _scanInt(_scanChar(q, e, ','), e, &b);
+        if (t) {
+          a = b;
+          b = 0xFFFF;
+          q = t;
+        }
+        if ((q = _scanHex(_scanChar(q, e, ','), e, &b))) {
+          r ++;
+          if ((q = _scanHex(_scanChar(q, e, ','), e, &c))) {
+            r ++;
+            if (_scanInt(_scanChar(q, e, ','), e, &d))
+              r ++;
+          }
+        }
+        Reg *reg = (urc == URC_CREG) ? &_net.csd : &_net.psd;
+        // network status
+        if      (a == 0) *reg = REG_NONE;     // 0: not registered, home network
+        else if (a == 1) *reg = REG_HOME;     // 1: registered, home network
+        else if (a == 2) *reg = REG_NONE;     // 2: not registered, but MT is currently searching a new operator to register to
+        else if (a == 3) *reg = REG_DENIED;   // 3: registration denied
+        else if (a == 4) *reg = REG_UNKNOWN;  // 4: unknown
+        else if (a == 5) *reg = REG_ROAMING;  // 5: registered, roaming
+        if ((r >= 2) && (b != 0xFFFF))                _net.lac = b; // location area code
+        if ((r >= 3) && ((unsigned)c != 0xFFFFFFFF))  _net.ci  = c; // cell ID
+        // access technology
+        if (r >= 4) {
+          if      (d == 0) _net.act = ACT_GSM;      // 0: GSM
+          else if (d == 1) _net.act = ACT_GSM;      // 1: GSM COMPACT
+          else if (d == 2) _net.act = ACT_UTRAN;    // 2: UTRAN
+          else if (d == 3) _net.act = ACT_EDGE;     // 3: GSM with EDGE availability
+          else if (d == 4) _net.act = ACT_UTRAN;    // 4: UTRAN with HSDPA availability
+          else if (d == 5) _net.act = ACT_UTRAN;    // 5: UTRAN with HSUPA availability
+          else if (d == 6) _net.act = ACT_UTRAN;    // 6: UTRAN with HSDPA and HSUPA availability
+        }
+      }
+      break;
+  }
+  // the attached handlers
+  for (int i = 0; i < URC_HANDLERS; i ++) {
+    const UrcCtrl* h = &_urc[i];
+    if (h->cb && (h->len == nl + 1) && !memcmp(h->prefix + 1, n, nl))
+      h->cb(buf, len, h->param);
+  }
+}
+
+bool MDMParser::urcAttach(const char* prefix, _URCPTR cb, void* param /*= NULL*/)
+{
+  bool ok = false;
+  LOCK();
+  for (int i = 0; !ok && (i < URC_HANDLERS); i ++) {
+    if (!_urc[i].cb) {
+      _urc[i].prefix = prefix;
+      _urc[i].len    = strlen(prefix);
+      _urc[i].param  = param;
+      _urc[i].cb     = cb;
+      ok = true;
+    }
+  }
+  UNLOCK();
+  return ok;
+}
+
+void MDMParser::urcDetach(const char* prefix, _URCPTR cb)
+{
+  LOCK();
+  for (int i = 0; i < URC_HANDLERS; i ++) {
+    if ((_urc[i].cb == cb) && (strcmp(_urc[i].prefix, prefix) == 0))
+      _urc[i].cb = NULL;
+  }
+  UNLOCK();
+}
+
+void MDMParser::urcPoll(void)
+{
+  LOCK();
+  // the urcs are handled while parsing, stray responses are dropped
+  while (waitFinalResp(NULL, NULL, 0) != WAIT)
+    /*nothing*/;
+  UNLOCK();
+}
+
+int MDMParser::cmdSubmit(_CALLBACKPTR cb, _DONEPTR done, void* param,
+                         int timeout_ms, const char* format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  int handle = _cmdSubmit(cb, done, param, timeout_ms, format, args);
+  va_end(args);
+  return handle;
+}
+
+int MDMParser::_cmdSubmit(_CALLBACKPTR cb, _DONEPTR done, void* param,
+                          int timeout_ms, const char* format, va_list args)
+{
+  char cmd[CMD_SIZE];
+  int len = vsnprintf(cmd, sizeof(cmd), format, args);
+  if ((len < 0) || (len >= (int)sizeof(cmd)))
+    return SOCKET_ERROR;
+  int handle = SOCKET_ERROR;
+  // the queue is shared by all threads, but only briefly
+  __disable_irq();
+  int depth = _cmdW - _cmdR;
+  if (depth < CMD_QUEUE) {
+    handle = _cmdW;
+    CmdCtrl* c = &_cmd[handle % CMD_QUEUE];
+    c->handle     = handle;
+    c->cb         = cb;
+    c->done       = done;
+    c->param      = param;
+    c->timeout_ms = timeout_ms;
+    c->submitted  = us_ticker_read();
+    c->result     = WAIT;
+    c->latency    = 0;
+    memcpy(c->cmd, cmd, len + 1);
+    _cmdW = handle + 1;
+    if (depth + 1 > _cmdStats.peak)
+      _cmdStats.peak = depth + 1;
+  }
+  __enable_irq();
+  if (handle != SOCKET_ERROR)
+    urcWake();
+  return handle;
+}
+
+int MDMParser::cmdResult(int handle, int* latency_ms /*= NULL*/)
+{
+  int ret = NOT_FOUND;
+  __disable_irq();
+  const CmdCtrl* c = &_cmd[((unsigned int)handle) % CMD_QUEUE];
+  if ((handle >= 0) && (c->handle == handle)) {
+    ret = c->result;
+    if (latency_ms)
+      *latency_ms = c->latency;
+  }
+  __enable_irq();
+  return ret;
+}
+
+void MDMParser::cmdPoll(void)
+{
+  // the queued commands have to wait until the direct link is left
+  while ((_cmdR != _cmdW) && (_direct == SOCKET_ERROR)) {
+    CmdCtrl* c = &_cmd[_cmdR % CMD_QUEUE];
+    int ret;
+    LOCK();
+    send(c->cmd, strlen(c->cmd));
+    ret = waitFinalResp(c->cb, c->param, c->timeout_ms);
+    UNLOCK();
+    // unsigned, so the latency is right across the wrap of the ticker
+    int latency = (int)((uint32_t)(us_ticker_read() - c->submitted) / 1000);
+    __disable_irq();
+    c->latency = latency;
+    c->result = ret;
+    _cmdStats.done ++;
+    if (ret != RESP_OK)
+      _cmdStats.failed ++;
+    _cmdStats.latency = latency;
+    _cmdStats.latencySum += latency;
+    if ((unsigned int)latency > _cmdStats.latencyMax)
+      _cmdStats.latencyMax = latency;
+    __enable_irq();
+    if (c->done)
+      c->done(c->handle, ret, latency, c->param);
+    // release the entry, the result stays until it is reused
+    _cmdR = _cmdR + 1;
+  }
+}
+
+bool MDMParser::cmdStats(CmdStats* st, bool reset /*= false*/)
+{
+  __disable_irq();
+  if (st) {
+    *st = _cmdStats;
+    st->depth = _cmdW - _cmdR;
+  }
+  if (reset) {
+    memset(&_cmdStats, 0, sizeof(_cmdStats));
+    _cmdStats.peak = _cmdW - _cmdR;
+  }
+  __enable_irq();
+  return true;
+}
+
 int MDMParser::_cbString(int type, const char* buf, int len, char* str)
 {
   if (str && (type == TYPE_UNKNOWN)) {
@@ -317,6 +599,7 @@ bool MDMParser::init(const char* simpin, DevStatus* status, PinName pn)
   int i = 10;
   LOCK();
   memset(&_dev, 0, sizeof(_dev));
+  _warm = false;
   if (pn != NC) {
     INFO("Modem::wakeup\r\n");
     DigitalOut pin(pn, 1);
@@ -481,6 +764,13 @@ bool MDMParser::init(const char* simpin, DevStatus* status, PinName pn)
   sendFormated("AT+CIMI\r\n");
   if (RESP_OK != waitFinalResp(_cbString, _dev.imsi))
     goto failure;
+  if (_dev.dev != DEV_LISA_C200) {
+    // save the configuration in the profile, so initWarm finds it in
+    // place even if the modem was reset meanwhile
+    sendFormated("AT&W\r\n");
+    if (RESP_OK != waitFinalResp())
+      goto failure;
+  }
   if (status)
     memcpy(status, &_dev, sizeof(DevStatus));
   UNLOCK();
@@ -490,6 +780,44 @@ failure:
     return false;
 }
 
+int MDMParser::_cbWarm(int type, const char* buf, int len, WarmParam* param)
+{
+  if ((type == TYPE_PLUS) && param) {
+    if      (!strncmp(buf, "\r\n+CREG:", 8)) sscanf(buf, "\r\n+CREG: %d,", &param->creg);
+    else if (!strncmp(buf, "\r\n+CPIN:", 8)) _cbCPIN(type, buf, len, &param->sim);
+    else if (!strncmp(buf, "\r\n+CCID:", 8)) _cbCCID(type, buf, len, param->ccid);
+  }
+  return WAIT;
+}
+
+bool MDMParser::initWarm(const DevStatus* cached, const char* simpin, DevStatus* status, PinName pn)
+{
+  bool ok = false;
+  LOCK();
+  if (cached && (cached->dev != DEV_UNKNOWN) && (cached->dev != DEV_LISA_C200)) {
+    INFO("Modem::initWarm\r\n");
+    memcpy(&_dev, cached, sizeof(_dev));
+    purge();
+    // the registration urcs are only enabled (+CREG: 2,..) by a
+    // configuration of init, the sim card has to be the same
+    WarmParam param = { 0, SIM_UNKNOWN, "" };
+    sendFormated("AT+CREG?;+CPIN?;+CCID\r\n");
+    if ((RESP_OK == waitFinalResp(_cbWarm, &param, 1000)) && (param.creg == 2) &&
+        (param.sim == SIM_READY) && !strcmp(param.ccid, cached->ccid)) {
+      _init = _warm = true;
+      ok = true;
+    }
+  }
+  UNLOCK();
+  if (!ok) {
+    INFO("Modem::initWarm not configured\r\n");
+    return init(simpin, status, pn);
+  }
+  if (status)
+    memcpy(status, &_dev, sizeof(DevStatus));
+  return true;
+}
+
 bool MDMParser::powerOff(void)
 {
   bool ok = false;
@@ -498,7 +826,7 @@ bool MDMParser::powerOff(void)
     INFO("Modem::powerOff\r\n");
     sendFormated("AT+CPWROFF\r\n");
     if (RESP_OK == waitFinalResp(NULL,NULL,120*1000)) {
-      _init = false;
+      _init = _warm = false;
       ok = true;
     }
     UNLOCK();
@@ -560,9 +888,37 @@ bool MDMParser::checkNetStatus(NetStatus* status /*= NULL*/)
 {
   bool ok = false;
   LOCK();
+  // the phone number belongs to the subscriber, keep it
+  char num[sizeof(_net.num)];
+  memcpy(num, _net.num, sizeof(num));
   memset(&_net, 0, sizeof(_net));
   _net.lac = 0xFFFF;
   _net.ci = 0xFFFFFFFF;
+  if (_dev.dev != DEV_LISA_C200) {
+    // all queries in one command line, the information responses are
+    // handled by _handleUrc (+CREG, +CGREG) and _cbNet, if the modem
+    // rejects a part, the queries are repeated one by one
+    sendFormated("AT+CREG?;+CGREG?;+COPS?;+CSQ\r\n");
+    if (RESP_OK == waitFinalResp(_cbNet, &_net)) {
+      if (REG_OK(_net.csd) || REG_OK(_net.psd)) {
+        memcpy(_net.num, num, sizeof(num));
+        if (!*_net.num) {
+          // get the MSISDNs related to this subscriber
+          sendFormated("AT+CNUM\r\n");
+          if (RESP_OK != waitFinalResp(_cbCNUM, _net.num))
+            goto failure;
+        }
+      } else {
+        // as if queried one by one
+        memset(_net.opr, 0, sizeof(_net.opr));
+        _net.rssi = _net.ber = 0;
+      }
+      goto done;
+    }
+    memset(&_net, 0, sizeof(_net));
+    _net.lac = 0xFFFF;
+    _net.ci = 0xFFFFFFFF;
+  }
   // check registration
   sendFormated("AT+CREG?\r\n");
   waitFinalResp();     // don't fail as service could be not subscribed
@@ -637,17 +993,67 @@ bool MDMParser::checkNetStatus(NetStatus* status /*= NULL*/)
     if (RESP_OK != waitFinalResp(_cbCSQ, &_net))
       goto failure;
   }
+done:
   if (status) {
     memcpy(status, &_net, sizeof(NetStatus));
   }
+  _netTime = _clock();
+  _netValid = true;
   ok = REG_DONE(_net.csd) && REG_DONE(_net.psd);
   UNLOCK();
   return ok;
 failure:
+  _netValid = false;
   unlock();
   return false;
 }
 
+bool MDMParser::netStatus(NetStatus* status, int maxAge_ms)
+{
+  bool fresh;
+  LOCK();
+  // pick up the urcs already received, nothing is sent to the modem
+  while (waitFinalResp(NULL, NULL, 0) != WAIT)
+    /* nothing */;
+  fresh = _netValid && ((maxAge_ms == TIMEOUT_BLOCKING) ||
+                        (_clock() - _netTime <= (uint64_t)maxAge_ms));
+  if (fresh)
+    memcpy(status, &_net, sizeof(NetStatus));
+  UNLOCK();
+  if (!fresh)
+    return checkNetStatus(status);
+  return REG_DONE(status->csd) && REG_DONE(status->psd);
+}
+
+bool MDMParser::checkSignal(NetStatus* status /*= NULL*/)
+{
+  bool ok = false;
+  LOCK();
+  int rssi = _net.rssi;
+  int ber = _net.ber;
+  _net.rssi = _net.ber = 0;
+  sendFormated("AT+CSQ\r\n");
+  ok = (RESP_OK == waitFinalResp(_cbCSQ, &_net));
+  if (!ok) {
+    _net.rssi = rssi;
+    _net.ber = ber;
+  }
+  if (status) {
+    memcpy(status, &_net, sizeof(NetStatus));
+  }
+  UNLOCK();
+  return ok;
+}
+
+int MDMParser::_cbNet(int type, const char* buf, int len, NetStatus* status)
+{
+  if ((type == TYPE_PLUS) && status) {
+    if      (!strncmp(buf, "\r\n+COPS:", 8)) _cbCOPS(type, buf, len, status);
+    else if (!strncmp(buf, "\r\n+CSQ:", 7))  _cbCSQ(type, buf, len, status);
+  }
+  return WAIT;
+}
+
 int MDMParser::_cbCOPS(int type, const char* buf, int len, NetStatus* status)
 {
   if ((type == TYPE_PLUS) && status){
@@ -723,9 +1129,9 @@ MDMParser::IP MDMParser::join(const char* apn /*= NULL*/, const char* username /
     if (RESP_OK != waitFinalResp(NULL,NULL,3*60*1000))
       goto failure;
 
-    // Check the profile
+    // Check the profile, a warm start keeps it if it is connected
     int a = 0;
-    bool force = true;
+    bool force = !_warm;
     sendFormated("AT+UPSND=" PROFILE ",8\r\n");
     if (RESP_OK != waitFinalResp(_cbUPSND, &a))
       goto failure;
@@ -798,6 +1204,8 @@ MDMParser::IP MDMParser::join(const char* apn /*= NULL*/, const char* username /
     if (RESP_OK != waitFinalResp(_cbUPSND, &_ip))
       goto failure;
   }
+  // the names kept from before, failures in particular, are stale now
+  _dnsFlush(NULL);
   UNLOCK();
   return _ip;
 failure:
@@ -886,14 +1294,67 @@ MDMParser::IP MDMParser::gethostbyname(const char* host)
     ip = IPADR(a,b,c,d);
   else {
     LOCK();
-    sendFormated("AT+UDNSRN=0,\"%s\"\r\n", host);
-    if (RESP_OK != waitFinalResp(_cbUDNSRN, &ip))
-      ip = NOIP;
+    uint64_t now = _clock();
+    DnsCtrl* e = NULL;
+    for (int i = 0; i < DNS_CACHE; i ++) {
+      // drop the expired names on the way, failures expire earlier
+      uint64_t ttl = (_dns[i].ip != NOIP) ? DNS_TTL_MS : DNS_NEG_TTL_MS;
+      if (_dns[i].host[0] && (now - _dns[i].time > ttl))
+        _dns[i].host[0] = '\0';
+      if (_dns[i].host[0] && !strcmp(_dns[i].host, host))
+        e = &_dns[i];
+    }
+    if (e) {
+      _dnsStats.hits ++;
+      ip = e->ip;
+    } else {
+      _dnsStats.misses ++;
+      sendFormated("AT+UDNSRN=0,\"%s\"\r\n", host);
+      if (RESP_OK != waitFinalResp(_cbUDNSRN, &ip))
+        ip = NOIP;
+      if (strlen(host) < DNS_NAME_SIZE) {
+        // take a free entry or the oldest one
+        e = &_dns[0];
+        for (int i = 1; (i < DNS_CACHE) && e->host[0]; i ++) {
+          if (!_dns[i].host[0] || (_dns[i].time < e->time))
+            e = &_dns[i];
+        }
+        strcpy(e->host, host);
+        e->ip = ip;
+        e->time = now;
+      }
+    }
     UNLOCK();
   }
   return ip;
 }
 
+void MDMParser::dnsFlush(const char* host /*= NULL*/)
+{
+  LOCK();
+  _dnsFlush(host);
+  UNLOCK();
+}
+
+void MDMParser::_dnsFlush(const char* host)
+{
+  for (int i = 0; i < DNS_CACHE; i ++) {
+    if (!host || !strcmp(_dns[i].host, host))
+      _dns[i].host[0] = '\0';
+  }
+}
+
+bool MDMParser::dnsStats(DnsStats* st, bool reset /*= false*/)
+{
+  LOCK();
+  if (st)
+    *st = _dnsStats;
+  if (reset)
+    memset(&_dnsStats, 0, sizeof(_dnsStats));
+  UNLOCK();
+  return true;
+}
+
 // ----------------------------------------------------------------
 // sockets
 
@@ -931,9 +1392,12 @@ int MDMParser::socketSocket(IpProtocol ipproto, int port)
         (handle != SOCKET_ERROR)) {
       TRACE("Socket %d: handle %d was created\r\n", socket, handle);
       _sockets[socket].handle     = handle;
+      _sockets[socket].ipproto    = ipproto;
       _sockets[socket].timeout_ms = TIMEOUT_BLOCKING;
       _sockets[socket].connected  = false;
       _sockets[socket].pending    = 0;
+      _sockets[socket].rx         = NULL;
+      _sockets[socket].tx         = NULL;
     }
     else
       socket = SOCKET_ERROR;
@@ -987,6 +1451,11 @@ bool MDMParser::socketClose(int socket)
 {
   bool ok = false;
   LOCK();
+  if (_direct == socket)
+    socketDirectLeave(socket);
+  // the gathered data goes out first
+  if (ISSOCKET(socket) && _sockets[socket].connected && _sockets[socket].tx)
+    _socketFlush(socket);
   if (ISSOCKET(socket) && _sockets[socket].connected) {
     TRACE("socketClose(%d)\r\n", socket);
     sendFormated("AT+USOCL=%d\r\n", _sockets[socket].handle);
@@ -1011,92 +1480,426 @@ bool MDMParser::socketFree(int socket)
     _sockets[socket].timeout_ms = TIMEOUT_BLOCKING;
     _sockets[socket].connected  = false;
     _sockets[socket].pending    = 0;
+    _sockets[socket].rx         = NULL;
+    _sockets[socket].tx         = NULL;
     ok = true;
   }
   UNLOCK();
   return ok;
 }
 
+int MDMParser::_cbCONNECT(int type, const char* buf, int len, void* param)
+{
+  return (type == TYPE_CONNECT) ? RESP_OK : WAIT;
+}
+
+bool MDMParser::socketDirectLink(int socket)
+{
+  bool ok = false;
+  LOCK();
+  if (ISSOCKET(socket) && _sockets[socket].connected && (_direct == SOCKET_ERROR)) {
+    TRACE("socketDirectLink(%d)\r\n", socket);
+    sendFormated("AT+USODL=%d\r\n", _sockets[socket].handle);
+    if (RESP_OK == waitFinalResp(_cbCONNECT, NULL)) {
+      // the pending data is now streamed unframed
+      _sockets[socket].pending = 0;
+      _direct = socket;
+      ok = true;
+    }
+  }
+  UNLOCK();
+  return ok;
+}
+
+bool MDMParser::socketDirectLeave(int socket)
+{
+  bool ok = false;
+  LOCK();
+  if (ISSOCKET(socket) && (_direct == socket)) {
+    TRACE("socketDirectLeave(%d)\r\n", socket);
+    // the escape sequence needs silence before and after it
+    wait_ms(DL_GUARD_MS);
+    send("+++", 3);
+    wait_ms(DL_GUARD_MS);
+    _direct = SOCKET_ERROR;
+    // drop the rest of the data and the DISCONNECT, then resync
+    purge();
+    sendFormated("AT\r\n");
+    ok = (RESP_OK == waitFinalResp());
+  }
+  UNLOCK();
+  return ok;
+}
+
 #define USO_MAX_WRITE 1024 //!< maximum number of bytes to write to socket
+#define USO_MAX_READ  1024 //!< maximum number of bytes to read from socket
 
 int MDMParser::socketSend(int socket, const char * buf, int len)
 {
+  SocketVec vec = { buf, len };
+  return socketSendVec(socket, &vec, 1);
+}
+
+int MDMParser::socketSendTo(int socket, IP ip, int port, const char * buf, int len)
+{
+  SocketVec vec = { buf, len };
+  return socketSendToVec(socket, ip, port, &vec, 1);
+}
+
+int MDMParser::socketSendVec(int socket, const SocketVec* vec, int num)
+{
+  int len = 0;
+  for (int i = 0; i < num; i ++)
+    len += vec[i].len;
   TRACE("socketSend(%d,,%d)\r\n", socket,len);
-  int cnt = len;
-  while (cnt > 0) {
-    int blk = USO_MAX_WRITE;
-    if (cnt < blk)
-      blk = cnt;
-    bool ok = false;
+  if (_direct != SOCKET_ERROR) {
+    int cnt = SOCKET_ERROR;
     LOCK();
-    if (ISSOCKET(socket)) {
-      sendFormated("AT+USOWR=%d,%d\r\n",_sockets[socket].handle,blk);
-      if (RESP_PROMPT == waitFinalResp()) {
-        wait_ms(50);
-        send(buf, blk);
-        if (RESP_OK == waitFinalResp())
-          ok = true;
-      }
+    if (_direct == socket) {
+      cnt = 0;
+      for (int i = 0; i < num; i ++)
+        cnt += send(vec[i].buf, vec[i].len);
     }
     UNLOCK();
-    if (!ok)
-      return SOCKET_ERROR;
-    buf += blk;
-    cnt -= blk;
+    return cnt;
   }
-  return (len - cnt);
+  int delay_ms = SOCKET_ERROR;
+  int cnt = 0;
+  LOCK();
+  if (ISSOCKET(socket) && _sockets[socket].tx) {
+    delay_ms = _sockets[socket].txDelay;
+    // report the data queued up to a failed write, it stays in the buffer
+    for (int i = 0; i < num; i ++) {
+      int n = _socketGather(socket, vec[i].buf, vec[i].len);
+      if (n == SOCKET_ERROR) {
+        if (!cnt)
+          cnt = SOCKET_ERROR;
+        break;
+      }
+      cnt += n;
+      if (n < vec[i].len)
+        break;
+    }
+  }
+  UNLOCK();
+  if (delay_ms != SOCKET_ERROR) {
+    // the urc thread needs to know when the data is due
+    if ((delay_ms > 0) && (cnt > 0))
+      urcWake();
+    return cnt;
+  }
+  return _socketSendVec(socket, NOIP, 0, vec, num);
 }
 
-int MDMParser::socketSendTo(int socket, IP ip, int port, const char * buf, int len)
+int MDMParser::socketSendToVec(int socket, IP ip, int port, const SocketVec* vec, int num)
 {
+  int len = 0;
+  for (int i = 0; i < num; i ++)
+    len += vec[i].len;
   TRACE("socketSendTo(%d," IPSTR ",%d,,%d)\r\n", socket,IPNUM(ip),port,len);
-  int cnt = len;
-  while (cnt > 0) {
+  return _socketSendVec(socket, ip, port, vec, num);
+}
+
+int MDMParser::socketSendToBatch(int socket, SocketDatagram* dgrams, int num)
+{
+  // check the whole batch first, nothing is written if a datagram is bad
+  for (int i = 0; i < num; i ++)
+    dgrams[i].result = SOCKET_ERROR;
+  for (int i = 0; i < num; i ++) {
+    // a datagram is never split
+    if ((dgrams[i].ip == NOIP) || !dgrams[i].buf ||
+        (dgrams[i].len <= 0) || (dgrams[i].len > USO_MAX_WRITE))
+      return SOCKET_ERROR;
+  }
+  int cnt = 0;
+  LOCK();
+  TRACE("socketSendToBatch(%d,,%d)\r\n", socket,num);
+  for (int i = 0; i < num; i ++) {
+    SocketVec vec = { dgrams[i].buf, dgrams[i].len };
+    if (ISSOCKET(socket) &&
+        _socketWrite(socket, dgrams[i].ip, dgrams[i].port, &vec, 1, 0, dgrams[i].len)) {
+      dgrams[i].result = dgrams[i].len;
+      cnt ++;
+    }
+  }
+  UNLOCK();
+  return cnt;
+}
+
+int MDMParser::_socketSendVec(int socket, IP ip, int port, const SocketVec* vec, int num)
+{
+  int len = 0;
+  for (int i = 0; i < num; i ++)
+    len += vec[i].len;
+  int cnt = 0;
+  while (cnt < len) {
     int blk = USO_MAX_WRITE;
-    if (cnt < blk)
-      blk = cnt;
+    if (len - cnt < blk)
+      blk = len - cnt;
     bool ok = false;
     LOCK();
-    if (ISSOCKET(socket)) {
-      sendFormated("AT+USOST=%d,\"" IPSTR "\",%d,%d\r\n",_sockets[socket].handle,IPNUM(ip),port,blk);
-      if (RESP_PROMPT == waitFinalResp()) {
-        wait_ms(50);
-        send(buf, blk);
-        if (RESP_OK == waitFinalResp())
-          ok = true;
-      }
-    }
+    if (ISSOCKET(socket))
+      ok = _socketWrite(socket, ip, port, vec, num, cnt, blk);
     UNLOCK();
     if (!ok)
+      return cnt ? cnt : SOCKET_ERROR;
+    cnt += blk;
+  }
+  return cnt;
+}
+
+int MDMParser::_socketGather(int socket, const char* buf, int len)
+{
+  // gather the data, write the buffer once it reached its size
+  Pipe<char>* tx = _sockets[socket].tx;
+  int size = _sockets[socket].txSize;
+  if ((size <= 0) || (size > tx->capacity()))
+    size = tx->capacity();
+  int cnt = 0;
+  while (cnt < len) {
+    if (!tx->readable())
+      _sockets[socket].txTime = us_ticker_read();
+    cnt += tx->put(buf + cnt, len - cnt);
+    // the data queued so far stays in the buffer if the write fails
+    if ((tx->size() >= size) && (_socketFlush(socket) == SOCKET_ERROR))
+      return cnt ? cnt : SOCKET_ERROR;
+  }
+  return cnt;
+}
+
+bool MDMParser::_socketWrite(int socket, IP ip, int port, const SocketVec* vec, int num, int skip, int len)
+{
+  // one AT+USOWR (or AT+USOST to a ip) for len bytes of the fragments after skip
+  if (ip == NOIP)
+    sendFormated("AT+USOWR=%d,%d\r\n",_sockets[socket].handle,len);
+  else
+    sendFormated("AT+USOST=%d,\"" IPSTR "\",%d,%d\r\n",_sockets[socket].handle,IPNUM(ip),port,len);
+  if (RESP_PROMPT != waitFinalResp())
+    return false;
+  wait_ms(50);
+  // the fragments are streamed as they are, not copied together
+  for (int i = 0; (i < num) && (len > 0); i ++) {
+    int n = vec[i].len;
+    if (skip >= n) {
+      skip -= n;
+      continue;
+    }
+    n -= skip;
+    if (n > len)
+      n = len;
+    send(vec[i].buf + skip, n);
+    skip = 0;
+    len -= n;
+  }
+  return (RESP_OK == waitFinalResp());
+}
+
+int MDMParser::_socketFlush(int socket)
+{
+  Pipe<char>* tx = _sockets[socket].tx;
+  int cnt = 0;
+  while (tx->readable()) {
+    // a wrapped buffer is written as two fragments
+    Pipe<char>::Span s[2];
+    int blk = tx->readSpans(s);
+    if (blk > USO_MAX_WRITE)
+      blk = USO_MAX_WRITE;
+    SocketVec vec[2] = { { s[0].p, s[0].n }, { s[1].p, s[1].n } };
+    if (!_socketWrite(socket, NOIP, 0, vec, 2, 0, blk))
       return SOCKET_ERROR;
-    buf += blk;
-    cnt -= blk;
+    tx->readCommit(blk);
+    cnt += blk;
+  }
+  return cnt;
+}
+
+bool MDMParser::socketCoalesce(int socket, Pipe<char>* tx, int size, int delay_ms)
+{
+  bool ok = false;
+  LOCK();
+  if (ISSOCKET(socket)) {
+    TRACE("socketCoalesce(%d,%d,%d,%d)\r\n", socket, tx ? tx->capacity() : 0, size, delay_ms);
+    // the data gathered in the previous buffer goes out first
+    if (_sockets[socket].tx && _sockets[socket].connected)
+      _socketFlush(socket);
+    if (tx)
+      tx->reset();
+    _sockets[socket].tx      = tx;
+    _sockets[socket].txSize  = size;
+    _sockets[socket].txDelay = delay_ms;
+    ok = true;
+  }
+  UNLOCK();
+  return ok;
+}
+
+int MDMParser::socketFlush(int socket)
+{
+  int cnt = SOCKET_ERROR;
+  LOCK();
+  if (ISSOCKET(socket) && (_direct == SOCKET_ERROR)) {
+    TRACE("socketFlush(%d)\r\n", socket);
+    cnt = _sockets[socket].tx ? _socketFlush(socket) : 0;
+  }
+  UNLOCK();
+  return cnt;
+}
+
+int MDMParser::socketFlushPoll(void)
+{
+  int due = TIMEOUT_BLOCKING;
+  LOCK();
+  for (int socket = 0; (socket < NUMSOCKETS) && (_direct == SOCKET_ERROR); socket ++) {
+    if (ISSOCKET(socket) && _sockets[socket].tx && _sockets[socket].connected &&
+        (_sockets[socket].txDelay > 0) && _sockets[socket].tx->readable()) {
+      // the age is unsigned, so it is right across the wrap of the ticker
+      uint32_t age = (uint32_t)(us_ticker_read() - _sockets[socket].txTime) / 1000;
+      int left = (age >= (uint32_t)_sockets[socket].txDelay) ? 0 :
+                 (_sockets[socket].txDelay - (int)age);
+      if ((left <= 0) && (_socketFlush(socket) != SOCKET_ERROR))
+        continue;
+      // retry a failed write after another delay
+      if (left <= 0) {
+        _sockets[socket].txTime = us_ticker_read();
+        left = _sockets[socket].txDelay;
+      }
+      if ((due == TIMEOUT_BLOCKING) || (left < due))
+        due = left;
+    }
   }
-  return (len - cnt);
+  UNLOCK();
+  return due;
 }
 
 int MDMParser::socketReadable(int socket)
 {
   int pending = SOCKET_ERROR;
   LOCK();
-  if (ISSOCKET(socket) && _sockets[socket].connected) {
+  if (ISSOCKET(socket) && (_direct == socket)) {
+    pending = _recvable();
+  } else if (ISSOCKET(socket) && _sockets[socket].connected) {
     TRACE("socketReadable(%d)\r\n", socket);
     // allow to receive unsolicited commands
     waitFinalResp(NULL, NULL, 0);
     if (_sockets[socket].connected)
       pending = _sockets[socket].pending;
   }
+  // the data read ahead, it is still there after the socket was closed
+  if (ISSOCKET(socket) && _sockets[socket].rx && _sockets[socket].rx->readable())
+    pending = ((pending > 0) ? pending : 0) + _sockets[socket].rx->size();
   UNLOCK();
   return pending;
 }
 
+bool MDMParser::socketPrefetch(int socket, Pipe<char>* rx)
+{
+  bool ok = false;
+  LOCK();
+  if (ISSOCKET(socket)) {
+    TRACE("socketPrefetch(%d,%d)\r\n", socket, rx ? rx->capacity() : 0);
+    if (rx)
+      rx->reset();
+    _sockets[socket].rx = rx;
+    ok = true;
+  }
+  UNLOCK();
+  if (ok && rx)
+    urcWake();
+  return ok;
+}
+
+void MDMParser::socketFetch(void)
+{
+  LOCK();
+  for (int socket = 0; (socket < NUMSOCKETS) && (_direct == SOCKET_ERROR); socket ++) {
+    while (ISSOCKET(socket) && _sockets[socket].rx && _sockets[socket].connected &&
+           _sockets[socket].pending && (_socketFetch(socket) > 0))
+      /* nothing */;
+  }
+  UNLOCK();
+}
+
+int MDMParser::_socketRead(int socket, char* buf, int len)
+{
+  // with a sink the payload goes straight to buf, otherwise it needs
+  // space in the line next to the header and unsolicited commands
+  int blk = _sink(buf, len) ? USO_MAX_READ : MAX_SIZE;
+  if (len < blk) blk = len;
+  if (_sockets[socket].pending < blk)
+    blk = _sockets[socket].pending;
+  if (blk > 0) {
+    sendFormated("AT+USORD=%d,%d\r\n",_sockets[socket].handle, blk);
+    if (RESP_OK == waitFinalResp(_cbUSORD, buf))
+      _sockets[socket].pending -= blk;
+    else
+      blk = SOCKET_ERROR;
+  }
+  _sink(NULL, 0);
+  return blk;
+}
+
+int MDMParser::_socketFetch(int socket)
+{
+  // read into the free space of the buffer, the part up to its end first
+  Pipe<char>* rx = _sockets[socket].rx;
+  Pipe<char>::Span s[2];
+  rx->writeSpans(s);
+  int n = _socketRead(socket, s[0].p, s[0].n);
+  if (n > 0) {
+    rx->writeCommit(n);
+    pollWake();
+  }
+  return n;
+}
+
+int MDMParser::socketPoll(SocketPoll* fds, int num, int timeout_ms)
+{
+  int ready;
+  Timer timer;
+  timer.start();
+  for (;;) {
+    ready = 0;
+    LOCK();
+    // the urcs received meanwhile update the sockets
+    while (waitFinalResp(NULL, NULL, 0) != WAIT)
+      /* nothing */;
+    for (int i = 0; i < num; i ++) {
+      int socket = fds[i].socket;
+      int ev = SOCKET_CLOSED;
+      if (ISSOCKET(socket)) {
+        SockCtrl* s = &_sockets[socket];
+        bool tcp = (s->ipproto == IPPROTO_TCP);
+        ev = 0;
+        if ((_direct == socket) ? (_recvable() > 0) :
+            ((s->connected || !tcp) && (s->pending > 0)) || (s->rx && s->rx->readable()))
+          ev |= SOCKET_READABLE;
+        if (s->connected || !tcp)
+          ev |= SOCKET_WRITABLE;
+        if (tcp && !s->connected)
+          ev |= SOCKET_CLOSED;
+      }
+      fds[i].revents = ev & (fds[i].events | SOCKET_CLOSED);
+      if (fds[i].revents)
+        ready ++;
+    }
+    UNLOCK();
+    if (ready || (timeout_ms == 0) || TIMEOUT(timer, timeout_ms))
+      break;
+    pollWait((timeout_ms == TIMEOUT_BLOCKING) ? TIMEOUT_BLOCKING :
+             (timeout_ms + 1 - timer.read_ms()));
+  }
+  return ready;
+}
+
 int MDMParser::_cbUSORD(int type, const char* buf, int len, char* out)
 {
   if ((type == TYPE_PLUS) && out) {
-    int sz, sk;
-    if ((sscanf(buf, "\r\n+USORD: %d,%d,", &sk, &sz) == 2) &&
-        (buf[len-sz-2] == '\"') && (buf[len-1] == '\"')) {
-      memcpy(out, &buf[len-1-sz], sz);
+    int sz, sk, n = 0;
+    // the payload is in the line, unless it was streamed to out already,
+    // then only the quotes follow the header
+    if ((sscanf(buf, "\r\n+USORD: %d,%d,%n", &sk, &sz, &n) == 2) && n &&
+        (len == n + sz + 2) && (buf[n] == '\"') && (buf[len-1] == '\"')) {
+      memcpy(out, &buf[n+1], sz);
     }
   }
   return WAIT;
@@ -1111,30 +1914,47 @@ int MDMParser::socketRecv(int socket, char* buf, int len)
 #endif
   Timer timer;
   timer.start();
+  if (_direct != SOCKET_ERROR) {
+    // direct link, return what is available as soon as there is something
+    bool ok = false;
+    LOCK();
+    if (_direct == socket) {
+      ok = true;
+      while (!(cnt = _recv(buf, len)) && !TIMEOUT(timer, _sockets[socket].timeout_ms))
+        waitRx((_sockets[socket].timeout_ms == TIMEOUT_BLOCKING) ? TIMEOUT_BLOCKING :
+               (_sockets[socket].timeout_ms + 1 - timer.read_ms()));
+    }
+    UNLOCK();
+    return ok ? cnt : SOCKET_ERROR;
+  }
   while (len) {
-    int blk = MAX_SIZE; // still need space for headers and unsolicited  commands
-    if (len < blk) blk = len;
     bool ok = false;
+    bool idle = false;
+    int tmo = TIMEOUT_BLOCKING;
     LOCK();
     if (ISSOCKET(socket)) {
-      if (_sockets[socket].connected) {
-        if (_sockets[socket].pending < blk)
-          blk = _sockets[socket].pending;
-        if (blk > 0) {
-          sendFormated("AT+USORD=%d,%d\r\n",_sockets[socket].handle, blk);
-          if (RESP_OK == waitFinalResp(_cbUSORD, buf)) {
-            _sockets[socket].pending -= blk;
-            len -= blk;
-            cnt += blk;
-            buf += blk;
-            ok = true;
-          }
-        } else if (!TIMEOUT(timer, _sockets[socket].timeout_ms)) {
-          ok = (WAIT == waitFinalResp(NULL,NULL,0)); // wait for URCs
-        } else {
-          len = 0;
-          ok = true;
-        }
+      // the data read ahead first, also when the socket is closed already
+      Pipe<char>* rx = _sockets[socket].rx;
+      int blk = rx ? rx->get(buf, len) : 0;
+      if (!blk && _sockets[socket].connected) {
+        if (!rx)
+          blk = _socketRead(socket, buf, len);
+        else if ((blk = _socketFetch(socket)) > 0)
+          blk = rx->get(buf, len);
+      }
+      if (blk > 0) {
+        len -= blk;
+        cnt += blk;
+        buf += blk;
+        ok = true;
+      } else if (blk < 0) {
+        /* failed */;
+      } else if (_sockets[socket].connected && !TIMEOUT(timer, _sockets[socket].timeout_ms)) {
+        ok = (WAIT == waitFinalResp(NULL,NULL,0)); // wait for URCs
+        // sleep only if the urcs did not change the socket meanwhile
+        idle = ok && _sockets[socket].connected && !_sockets[socket].pending &&
+               !(rx && rx->readable());
+        tmo = _sockets[socket].timeout_ms;
       } else {
         len = 0;
         ok = true;
@@ -1145,6 +1965,14 @@ int MDMParser::socketRecv(int socket, char* buf, int len)
       TRACE("socketRecv: ERROR\r\n");
     return SOCKET_ERROR;
     }
+    // sleep until more data arrives, but not beyond the timeout
+    if (idle && (tmo == TIMEOUT_BLOCKING))
+      readWait(TIMEOUT_BLOCKING);
+    else if (idle) {
+      int left = tmo + 1 - timer.read_ms();
+      if (left > 0)
+        readWait(left);
+    }
   }
   TRACE("socketRecv: %d \"%*s\"\r\n", cnt, cnt, buf-cnt);
   return cnt;
@@ -1177,6 +2005,8 @@ int MDMParser::socketRecvFrom(int socket, IP* ip, int* port, char* buf, int len)
     int blk = MAX_SIZE; // still need space for headers and unsolicited commands
     if (len < blk) blk = len;
     bool ok = false;
+    bool idle = false;
+    int tmo = TIMEOUT_BLOCKING;
     LOCK();
     if (ISSOCKET(socket)) {
       if (_sockets[socket].pending < blk)
@@ -1197,6 +2027,9 @@ int MDMParser::socketRecvFrom(int socket, IP* ip, int* port, char* buf, int len)
         }
       } else if (!TIMEOUT(timer, _sockets[socket].timeout_ms)) {
         ok = (WAIT == waitFinalResp(NULL,NULL,0)); // wait for URCs
+        // sleep only if the urcs did not bring data meanwhile
+        idle = ok && !_sockets[socket].pending;
+        tmo = _sockets[socket].timeout_ms;
       } else {
         len = 0; // no more data and socket closed or timed-out
         ok = true;
@@ -1207,6 +2040,14 @@ int MDMParser::socketRecvFrom(int socket, IP* ip, int* port, char* buf, int len)
       TRACE("socketRecv: ERROR\r\n");
       return SOCKET_ERROR;
     }
+    // sleep until more data arrives, but not beyond the timeout
+    if (idle && (tmo == TIMEOUT_BLOCKING))
+      readWait(TIMEOUT_BLOCKING);
+    else if (idle) {
+      int left = tmo + 1 - timer.read_ms();
+      if (left > 0)
+        readWait(left);
+    }
   }
   timer.stop();
   timer.reset();
@@ -1467,133 +2308,258 @@ void MDMParser::dumpIp(MDMParser::IP ip,
 }
 
 // ----------------------------------------------------------------
-int MDMParser::_parseMatch(Pipe<char>* pipe, int len, const char* sta, const char* end)
+int MDMParser::_lexRest(Pipe<char>* pipe, int len, LexState* st)
 {
-  int o = 0;
-  if (sta) {
-    while (*sta) {
-      if (++o > len)      return WAIT;
+  if (!st->fmt) {
+    // a line, at least any char followed by "\r\n", sub counts the matched end
+    static const char end[] = "\r\n";
+    while (st->sub < 2) {
+      if (st->o >= len)         return WAIT;
       char ch = pipe->next();
-      if (*sta++ != ch)   return NOT_FOUND;
+      st->o ++;
+      st->sub = (st->sub < 0)      ? 0 :
+                (end[st->sub] == ch) ? st->sub + 1 :
+                (end[0] == ch)       ? 1 :
+                                       0;
     }
+    return st->o;
   }
-  if (!end)               return o; // no termination
-  // at least any char
-  if (++o > len)          return WAIT;
-  pipe->next();
-  // check the end
-  int x = 0;
-  while (end[x]) {
-    if (++o > len)        return WAIT;
+  while (*st->fmt) {
+    if (st->o >= len)           return WAIT;
     char ch = pipe->next();
-    x = (end[x] == ch) ? x + 1 :
-        (end[0] == ch) ? 1 :
-                        0;
-  }
-  return o;
-}
-
-int MDMParser::_parseFormated(Pipe<char>* pipe, int len, const char* fmt)
-{
-  int o = 0;
-  int num = 0;
-  if (fmt) {
-    while (*fmt) {
-      if (++o > len)            return WAIT;
-      char ch = pipe->next();
-      if (*fmt == '%') {
-        fmt++;
-        if (*fmt == 'd') { // numeric
-          fmt ++;
-          num = 0;
-          while (ch >= '0' && ch <= '9') {
-            num = num * 10 + (ch - '0');
-            if (++o > len)      return WAIT;
-            ch = pipe->next();
-          }
+    st->o ++;
+    const char* fmt = st->fmt;
+    if (*fmt == '%') {
+      fmt ++;
+      if (*fmt == 'd') { // numeric
+        fmt ++;
+        if (!st->sub) {
+          st->num = 0;
+          st->sub = 1;
         }
-        else if (*fmt == 'c') { // char buffer (takes last numeric as length)
-          fmt ++;
-          while (num --) {
-            if (++o > len)      return WAIT;
-            ch = pipe->next();
-          }
+        if (ch >= '0' && ch <= '9') {
+          st->num = st->num * 10 + (ch - '0');
+          continue;
+        }
+      }
+      else if (*fmt == 'c') { // char buffer (takes last numeric as length)
+        fmt ++;
+        if (!st->sub) {
+          // ch is the first of the payload, sub is 1 inside it
+          st->sub = 1;
+          st->hdr = st->o - 1;
+          st->pay = st->num;
+        }
+        if (st->num > 0) {
+          st->num --;
+          continue;
         }
-        else if (*fmt == 's') {
-          fmt ++;
+      }
+      else if (*fmt == 's') { // quoted string, sub is 1 inside the quotes
+        fmt ++;
+        if (st->sub == 0) {
           if (ch != '\"')       return NOT_FOUND;
-          do {
-            if (++o > len)      return WAIT;
-            ch = pipe->next();
-          } while (ch != '\"');
-          if (++o > len)        return WAIT;
-          ch = pipe->next();
+          st->sub = 1;
+          continue;
+        }
+        if (st->sub == 1) {
+          if (ch == '\"')
+            st->sub = 2;
+          continue;
         }
       }
-      if (*fmt++ != ch)         return NOT_FOUND;
     }
+    if (*fmt++ != ch)           return NOT_FOUND;
+    st->fmt = fmt;
+    st->sub = 0;
   }
-  return o;
+  return st->o;
+}
+
+int MDMParser::_lexLine(Pipe<char>* pipe, int ix, int len, bool wait, LexState* st)
+{
+  // the keywords following "\r\n", this table has to be prefix free
+  static const struct {
+      const char* sta;  const char* fmt;                  bool line;  int type;
+  } lut[] = {
+    { "OK\r\n",          NULL,                            false,      TYPE_OK         },
+    { "ERROR\r\n",       NULL,                            false,      TYPE_ERROR      },
+    { "RING\r\n",        NULL,                            false,      TYPE_RING       },
+    { "CONNECT\r\n",     NULL,                            false,      TYPE_CONNECT    },
+    { "NO CARRIER\r\n",  NULL,                            false,      TYPE_NOCARRIER  },
+    { "NO DIALTONE\r\n", NULL,                            false,      TYPE_NODIALTONE },
+    { "BUSY\r\n",        NULL,                            false,      TYPE_BUSY       },
+    { "NO ANSWER\r\n",   NULL,                            false,      TYPE_NOANSWER   },
+    { "+USORD: ",        "%d,%d,\"%c\"",                   false,      TYPE_PLUS       },
+    { "+USORF: ",        "%d,\"" IPSTR "\",%d,%d,\"%c\"",  false,      TYPE_PLUS       },
+    { "+URDFILE: ",      "%s,%d,\"%c\"",                   false,      TYPE_PLUS       },
+    { "+CME ERROR:",     NULL,                            true,       TYPE_ERROR      },
+    { "+CMS ERROR:",     NULL,                            true,       TYPE_ERROR      },
+    { "@",               NULL,                            false,      TYPE_PROMPT     }, // Sockets
+    { ">",               NULL,                            false,      TYPE_PROMPT     }, // SMS
+  };
+  const int num = sizeof(lut)/sizeof(*lut);
+  int ln = NOT_FOUND;
+  if (st->o) {
+    // continue the response pending from the last call
+    pipe->set(ix + st->o);
+    ln = _lexRest(pipe, len, st);
+  } else {
+    pipe->set(ix);
+    char ch = pipe->next();
+    if (ch == '\n') { // "\n>" File
+      if (len < 2)              return WAIT;
+      return (pipe->next() == '>') ? (TYPE_PROMPT | 2) : NOT_FOUND;
+    }
+    if (len < 2)                return WAIT;
+    if (pipe->next() != '\n')   return NOT_FOUND;
+    // walk all keywords in parallel, m holds the ones still matching
+    unsigned int m = (1 << num) - 1;
+    int o = 2;
+    int k = -1;
+    for (int i = 0; m && (k < 0); i ++) {
+      if (o >= len) {
+        ln = WAIT;
+        break;
+      }
+      ch = pipe->next();
+      o ++;
+      for (int j = 0; j < num; j ++) {
+        if (!(m & (1 << j)))
+          continue;
+        if (lut[j].sta[i] != ch)
+          m &= ~(1 << j);
+        else if (!lut[j].sta[i+1])
+          k = j;
+      }
+    }
+    if (k >= 0) {
+      if (!lut[k].fmt && !lut[k].line)
+        return lut[k].type | o;
+      // continue a formated response or a line
+      st->o    = o;
+      st->type = lut[k].type;
+      st->fmt  = lut[k].fmt;
+      st->num  = 0;
+      st->sub  = lut[k].fmt ? 0 : -1;
+      ln = _lexRest(pipe, len, st);
+    }
+  }
+  if (ln > 0) {
+    st->o = 0;
+    return st->type | ln;
+  }
+  if ((ln == WAIT) && (wait || _lexSink(st))) return WAIT;
+  // a formated response that did not match is any other "\r\n+" line,
+  // as all are starting with a '+'
+  bool plus = st->o && st->fmt;
+  st->o = 0;
+  if (!plus) {
+    pipe->set(ix + 2);
+    if ((len < 3) || (pipe->next() != '+'))
+      return NOT_FOUND;
+  }
+  st->o    = 3;
+  st->type = TYPE_PLUS;
+  st->fmt  = NULL;
+  st->sub  = -1;
+  pipe->set(ix + 3);
+  ln = _lexRest(pipe, len, st);
+  if (ln > 0) {
+    st->o = 0;
+    return TYPE_PLUS | ln;
+  }
+  if ((ln == WAIT) && wait)     return WAIT;
+  st->o = 0;
+  return NOT_FOUND;
 }
 
-int MDMParser::_getLine(Pipe<char>* pipe, char* buf, int len)
+int MDMParser::_lexStream(Pipe<char>* pipe, char* buf, int len, LexState* st)
 {
-  int unkn = 0;
+  if (st->cp < st->pay) {
+    st->cp += pipe->get(st->dst + st->cp, st->pay - st->cp);
+    if (st->cp < st->pay)
+      return WAIT;
+  }
+  // the rest of the format follows the payload, e.g. the closing quote
+  while (*st->fmt) {
+    if (!pipe->readable())
+      return WAIT;
+    char ch = pipe->getc();
+    if ((ch != *st->fmt) || (st->hdr >= len)) {
+      int n = st->hdr;
+      _lexReset(st);
+      return TYPE_UNKNOWN | n;
+    }
+    buf[st->hdr++] = ch;
+    st->fmt ++;
+  }
+  int ret = st->type | st->hdr;
+  _lexReset(st);
+  return ret;
+}
+
+int MDMParser::_getLine(Pipe<char>* pipe, char* buf, int len, LexState* st)
+{
+  // continue the payload streamed into the sink
+  if (st->cp >= 0)
+    return _lexStream(pipe, buf, len, st);
+  int max = len;
   int sz = pipe->size();
   int fr = pipe->free();
   if (len > sz)
     len = sz;
-  while (len > 0)
-  {
-    static struct {
-        const char* fmt;                              int type;
-    } lutF[] = {
-      { "\r\n+USORD: %d,%d,\"%c\"",                   TYPE_PLUS       },
-      { "\r\n+USORF: %d,\"" IPSTR "\",%d,%d,\"%c\"",  TYPE_PLUS       },
-      { "\r\n+URDFILE: %s,%d,\"%c\"",                 TYPE_PLUS       },
-    };
-    static struct {
-        const char* sta;          const char* end;    int type;
-    } lut[] = {
-      { "\r\nOK\r\n",             NULL,               TYPE_OK         },
-      { "\r\nERROR\r\n",          NULL,               TYPE_ERROR      },
-      { "\r\n+CME ERROR:",        "\r\n",             TYPE_ERROR      },
-      { "\r\n+CMS ERROR:",        "\r\n",             TYPE_ERROR      },
-      { "\r\nRING\r\n",           NULL,               TYPE_RING       },
-      { "\r\nCONNECT\r\n",        NULL,               TYPE_CONNECT    },
-      { "\r\nNO CARRIER\r\n",     NULL,               TYPE_NOCARRIER  },
-      { "\r\nNO DIALTONE\r\n",    NULL,               TYPE_NODIALTONE },
-      { "\r\nBUSY\r\n",           NULL,               TYPE_BUSY       },
-      { "\r\nNO ANSWER\r\n",      NULL,               TYPE_NOANSWER   },
-      { "\r\n+",                  "\r\n",             TYPE_PLUS       },
-      { "\r\n@",                  NULL,               TYPE_PROMPT     }, // Sockets
-      { "\r\n>",                  NULL,               TYPE_PROMPT     }, // SMS
-      { "\n>",                    NULL,               TYPE_PROMPT     }, // File
-    };
-    for (uint i = 0; i < sizeof(lutF)/sizeof(*lutF); i ++) {
-      pipe->set(unkn);
-      int ln = _parseFormated(pipe, len, lutF[i].fmt);
-      if (ln == WAIT && fr)
-        return WAIT;
-      if ((ln != NOT_FOUND) && (unkn > 0))
-        return TYPE_UNKNOWN | pipe->get(buf, unkn);
-      if (ln > 0)
-        return lutF[i].type  | pipe->get(buf, ln);
-    }
-    for (uint i = 0; i < sizeof(lut)/sizeof(*lut); i ++) {
-      pipe->set(unkn);
-      int ln = _parseMatch(pipe, len, lut[i].sta, lut[i].end);
-      if (ln == WAIT && fr)
+  // a full pipe is parsed from the start, incomplete responses are
+  // skipped then, so the data can be consumed, unless their payload
+  // goes to the sink
+  if ((!fr && !_lexSink(st)) || (st->ix + st->o > len))
+    _lexReset(st);
+  // a response can only start at a line break, skip anything else
+  Pipe<char>::Span s[2];
+  pipe->readSpans(s, st->ix);
+  int unkn = st->ix;
+  for (int i = 0; (i < 2) && (unkn < len); i ++) {
+    const char* p = s[i].p;
+    const char* e = p + s[i].n;
+    for ( ; (p < e) && (unkn < len); p ++, unkn ++) {
+      if ((*p != '\r') && (*p != '\n'))
+        continue;
+      int ln = _lexLine(pipe, unkn, len - unkn, fr || unkn, st);
+      if ((ln == WAIT) && _lexSink(st) && (st->hdr + 2 <= max)) {
+        // the payload is moved to the sink as it arrives, so the response
+        // needs neither fit into the pipe nor the line
+        if (unkn > 0) {
+          st->ix = 0;
+          return TYPE_UNKNOWN | pipe->get(buf, unkn);
+        }
+        pipe->get(buf, st->hdr);
+        st->cp = pipe->get(st->dst, st->o - st->hdr);
+        st->fmt += 2;
+        st->ix = st->o = 0;
+        return _lexStream(pipe, buf, max, st);
+      }
+      if (ln == WAIT && fr) {
+        st->ix = unkn;
         return WAIT;
-      if ((ln != NOT_FOUND) && (unkn > 0))
+      }
+      if ((ln != NOT_FOUND) && (unkn > 0)) {
+        // keep what was parsed, the response follows the unknown data
+        if (ln > 0) {
+          st->o    = LENGTH(ln);
+          st->type = TYPE(ln);
+          st->fmt  = NULL;
+          st->sub  = 2;
+        }
+        st->ix = 0;
         return TYPE_UNKNOWN | pipe->get(buf, unkn);
-      if (ln > 0)
-        return lut[i].type | pipe->get(buf, ln);
+      }
+      if (ln > 0) {
+        _lexReset(st);
+        return TYPE(ln) | pipe->get(buf, LENGTH(ln));
+      }
     }
-    // UNKNOWN
-    unkn ++;
-    len--;
   }
+  st->ix = unkn;
   return WAIT;
 }
 
@@ -1624,9 +2590,13 @@ MDMSerial::MDMSerial(PinName tx /*= MDMTXD*/, PinName rx /*= MDMRXD*/,
 #if DEVICE_SERIAL_FC
                      PinName rts /*= MDMRTS*/, PinName cts /*= MDMCTS*/,
 #endif
-                     int rxSize /*= 256*/, int txSize /*= 128*/) :
-                     SerialPipe(tx, rx, rxSize, txSize)
+                     int rxSize /*= 256*/, int txSize /*= 128*/,
+                     char* rxBuf /*= NULL*/, char* txBuf /*= NULL*/) :
+                     SerialPipe(tx, rx, rxSize, txSize, rxBuf, txBuf)
 {
+  _lexReset(&_lex);
+  _lex.dst = NULL;
+  _lex.dstLen = 0;
   if (rx == USBRX)
     null.claim("r", stdin);
   if (tx == USBTX) {
@@ -1639,12 +2609,14 @@ MDMSerial::MDMSerial(PinName tx /*= MDMTXD*/, PinName rx /*= MDMRXD*/,
   //c027_mdm_powerOn(false);
   baud(baudrate);
 #if DEVICE_SERIAL_FC
-  if ((rts != NC) || (cts != NC))
+  // rts follows the fill level of the rx pipe rather than the uart
+  // register, so the modem stops before the pipe would overflow
+  if (rts != NC)
+    rxFlow(rts, _pipeRx.capacity() * 3 / 4, _pipeRx.capacity() / 4);
+  if (cts != NC)
   {
-    Flow flow = (cts == NC) ? RTS :
-                (rts == NC) ? CTS : RTSCTS ;
-    set_flow_control(flow, rts, cts);
-    if (cts != NC) _dev.lpm = LPM_ENABLED;
+    set_flow_control(CTS, cts);
+    _dev.lpm = LPM_ENABLED;
   }
 #endif
 }
@@ -1662,7 +2634,25 @@ int MDMSerial::_send(const void* buf, int len)
 
 int MDMSerial::getLine(char* buffer, int length)
 {
-  return _getLine(&_pipeRx, buffer, length);
+  return _getLine(&_pipeRx, buffer, length, &_lex);
+}
+
+bool MDMSerial::_sink(char* buf, int len)
+{
+  // a response streaming into the old sink is abandoned, its rest
+  // is skipped as unknown data
+  if (_lex.cp >= 0)
+    _lexReset(&_lex);
+  _lex.dst = buf;
+  _lex.dstLen = buf ? len : 0;
+  return true;
+}
+
+int MDMSerial::_recv(void* buf, int len)
+{
+  // the lexer has to start over after the raw data
+  _lexReset(&_lex);
+  return get(buf, len, false/*=blocking*/);
 }
 
 // ----------------------------------------------------------------
@@ -1688,4 +2678,8 @@ int MDMUsb::_send(const void* buf, int len)      { return 0; }
 
 int MDMUsb::getLine(char* buffer, int length)    { return NOT_FOUND; }
 
+int MDMUsb::_recv(void* buf, int len)            { return 0; }
+
+int MDMUsb::_recvable(void)                      { return 0; }
+
 #endif
@@ -100,6 +100,23 @@ public:
   bool init(const char* simpin = NULL, DevStatus* status = NULL,
   PinName pn = PB_0);
 
+  /** take over a modem that is still powered, configured and attached,
+   *  e.g. after a reset of the MCU only. The modem is not woken up and not
+   *  configured again, its device information comes from cached (the
+   *  status of an earlier #init, e.g. kept in RAM that is not cleared at
+   *  reset). A single command checks that the configuration is still in
+   *  place (#init saves it in the profile with AT&W), the sim is ready and
+   *  is the same card. If not, it falls back to #init. #join then keeps a
+   *  connected data profile instead of starting it over. The sockets the
+   *  modem still has open from before are not taken over.
+   *  \param cached the device information from an earlier #init
+   *  \param simpin a optional pin of the SIM card, for the fall back
+   *  \param status an optional struture to with device information
+   *  \return true if successful, false otherwise
+   */
+  bool initWarm(const DevStatus* cached, const char* simpin = NULL,
+  DevStatus* status = NULL, PinName pn = PB_0);
+
   /** register to the network
    *  \param status an optional structure to with network information
    *  \param timeout_ms -1 blocking, else non blocking timeout in ms
@@ -113,6 +130,24 @@ public:
    */
   bool checkNetStatus(NetStatus* status = NULL);
 
+  /** check the signal strength only, faster than #checkNetStatus
+   *  \param status an optional structure to with network information,
+   *          only rssi and ber are updated, the rest is the last known status
+   *  \return true if successful, false otherwise
+   */
+  bool checkSignal(NetStatus* status = NULL);
+
+  /** get the cached network status, the registration, location area and
+   *  cell id are kept current by the +CREG and +CGREG urcs, the fields that
+   *  have to be polled (operator, signal strength) are refreshed with
+   *  #checkNetStatus once they are older than maxAge_ms
+   *  \param status the structure to with network information
+   *  \param maxAge_ms the maximum age of the polled fields in ms, 0 to
+   *          always refresh, TIMEOUT_BLOCKING to only refresh once
+   *  \return true if connected to network, false otherwise
+   */
+  bool netStatus(NetStatus* status, int maxAge_ms);
+
   /** Power off the MT, This function has to be called prior to
    *  switching off the supply.
    *  \return true if successfully, false otherwise
@@ -138,12 +173,40 @@ public:
    */
   bool disconnect(void);
 
-  /** Translates a domain name to an IP address
+  //! number of domain names kept by #gethostbyname
+  #define DNS_CACHE 4
+  //! maximum length of a kept domain name, longer ones are always looked up
+  #define DNS_NAME_SIZE 32
+  //! time a resolved domain name is kept in ms
+  #define DNS_TTL_MS (10*60*1000)
+  //! time a domain name that could not be resolved is kept in ms
+  #define DNS_NEG_TTL_MS (30*1000)
+
+  /** Translates a domain name to an IP address, the result (also a
+   *  failure) is kept for a while, see #DNS_TTL_MS and #DNS_NEG_TTL_MS
    *  \param host the domain name to translate e.g. "u-blox.com"
    *  \return the IP if successful, 0 otherwise
    */
   MDMParser::IP gethostbyname(const char* host);
 
+  /** Forget the kept results of #gethostbyname
+   *  \param host the domain name to forget, NULL to forget all
+   */
+  void dnsFlush(const char* host = NULL);
+
+  //! Statistics of the domain names kept by #gethostbyname
+  typedef struct {
+    unsigned int hits;    //!< number of lookups served from the cache
+    unsigned int misses;  //!< number of lookups sent to the modem
+  } DnsStats;
+
+  /** Get the statistics of the domain names kept by #gethostbyname
+   *  \param st the statistics
+   *  \param reset clear the counters
+   *  \return true if successful
+   */
+  bool dnsStats(DnsStats* st, bool reset = false);
+
   // ----------------------------------------------------------------
   // Sockets
   // ----------------------------------------------------------------
@@ -186,7 +249,9 @@ public:
    *  \param socket the socket handle
    *  \param buf the buffer to write
    *  \param len the size of the buffer to write
-   *  \return the size written or SOCKET_ERROR on failure
+   *  \return the size written (or queued in the send buffer, see
+   *          #socketCoalesce), less if a write failed after some data,
+   *          or SOCKET_ERROR on failure
    */
   int socketSend(int socket, const char * buf, int len);
 
@@ -200,12 +265,126 @@ public:
    */
   int socketSendTo(int socket, IP ip, int port, const char * buf, int len);
 
+  //! A fragment of the data to write, see #socketSendVec
+  typedef struct {
+    const char* buf; //!< the fragment
+    int len;         //!< the size of the fragment
+  } SocketVec;
+
+  /** Write socket data from several fragments (e.g. a header, a payload
+   *  and a trailer) in one transaction, without copying them together
+   *  \param socket the socket handle
+   *  \param vec the fragments to write
+   *  \param num the number of fragments
+   *  \return the size written or queued, less if a write failed after
+   *          some data, or SOCKET_ERROR on failure, see #socketSend
+   */
+  int socketSendVec(int socket, const SocketVec* vec, int num);
+
+  /** Write socket data from several fragments to a IP in one transaction
+   *  \param socket the socket handle
+   *  \param ip the ip to send to
+   *  \param port the port to send to
+   *  \param vec the fragments to write
+   *  \param num the number of fragments
+   *  \return the size written or SOCKET_ERROR on failure
+   */
+  int socketSendToVec(int socket, IP ip, int port, const SocketVec* vec, int num);
+
+  //! A datagram to write, see #socketSendToBatch
+  typedef struct {
+    IP ip;           //!< the ip to send to
+    int port;        //!< the port to send to
+    const char* buf; //!< the datagram
+    int len;         //!< the size of the datagram, up to 1024 bytes
+    int result;      //!< the size written or SOCKET_ERROR, filled by #socketSendToBatch
+  } SocketDatagram;
+
+  /** Write several datagrams back to back, the modem is taken once for
+   *  all of them, so other commands do not come in between.
+   *  \param socket the socket handle
+   *  \param dgrams the datagrams, their result is filled in
+   *  \param num the number of datagrams
+   *  \return the number of datagrams written, SOCKET_ERROR without writing
+   *          anything if a datagram has no ip or a size outside 1..1024
+   */
+  int socketSendToBatch(int socket, SocketDatagram* dgrams, int num);
+
   /** Get the number of bytes pending for reading for this socket
    *  \param socket the socket handle
    *  \return the number of bytes pending or SOCKET_ERROR on failure
    */
   int socketReadable(int socket);
 
+  /** Attach a receive buffer to a socket, the data is then read ahead as
+   *  soon as the modem reports it (+UUSORD), so #socketRecv and
+   *  #socketReadable are served from memory. The data is read ahead by
+   *  #socketFetch, which the urc thread of #MDMRtosUrc runs.
+   *  \param socket the socket handle
+   *  \param rx the buffer, e.g. a Pipe<char,512>, NULL to detach it, the
+   *          data left in it is dropped then
+   *  \return true if successfully, false otherwise
+   */
+  bool socketPrefetch(int socket, Pipe<char>* rx);
+
+  /** Read the pending data of the sockets with a receive buffer ahead,
+   *  until their buffers are full, see #socketPrefetch.
+   */
+  void socketFetch(void);
+
+  /** Attach a send buffer to a socket, the data of #socketSend is then
+   *  gathered and written with as few AT+USOWR as possible. The buffer is
+   *  written once it holds size bytes, once its oldest data waited
+   *  delay_ms (see #socketFlushPoll) and by #socketFlush or #socketClose.
+   *  \param socket the socket handle
+   *  \param tx the buffer, e.g. a Pipe<char,512>, NULL to detach it, the
+   *          data left in it is written first then
+   *  \param size the number of bytes that triggers the write, 0 when full
+   *  \param delay_ms the longest time data waits in the buffer, 0 to
+   *          wait for size or #socketFlush only
+   *  \return true if successfully, false otherwise
+   */
+  bool socketCoalesce(int socket, Pipe<char>* tx, int size = 0, int delay_ms = 0);
+
+  /** Write the data gathered in the send buffer of a socket
+   *  \param socket the socket handle
+   *  \return the number of bytes written or SOCKET_ERROR on failure
+   */
+  int socketFlush(int socket);
+
+  /** Write the send buffers whose oldest data waited their delay, see
+   *  #socketCoalesce. The urc thread of #MDMRtosUrc runs it, without it
+   *  call it periodically.
+   *  \return the time in ms until the next buffer is due,
+   *          TIMEOUT_BLOCKING if none
+   */
+  int socketFlushPoll(void);
+
+  //! Socket readiness events, see #socketPoll
+  typedef enum {
+    SOCKET_READABLE = 1, //!< data is pending or read ahead
+    SOCKET_WRITABLE = 2, //!< data can be sent, TCP connected or UDP
+    SOCKET_CLOSED   = 4  //!< TCP not (or no longer) connected, always reported
+  } SocketEvent;
+
+  //! A socket to wait for with #socketPoll
+  typedef struct {
+    int socket;   //!< the socket handle
+    int events;   //!< the events of interest, see #SocketEvent
+    int revents;  //!< the events that occurred, filled by #socketPoll
+  } SocketPoll;
+
+  /** Wait until any of the sockets is readable, writable or closed. The
+   *  sockets are updated by the urcs (+UUSORD, +UUSORF, +UUSOCL), so only
+   *  one thread should wait at a time.
+   *  \param fds the sockets and their events
+   *  \param num the number of sockets
+   *  \param timeout_ms the time to wait, 0 to only check,
+   *          TIMEOUT_BLOCKING to wait without limit
+   *  \return the number of sockets with events, 0 if timed out
+   */
+  int socketPoll(SocketPoll* fds, int num, int timeout_ms);
+
   /** Read this socket
    *  \param socket the socket handle
    *  \param buf the buffer to read into
@@ -236,6 +415,26 @@ public:
    */
   bool socketFree(int socket);
 
+  //! Guard time of the direct link escape sequence in ms
+  #define DL_GUARD_MS 1000
+
+  /** Switch a connected socket to direct link mode (transparent), the
+   *  data is then streamed unframed with #socketSend and #socketRecv at
+   *  line rate. The modem does not accept any AT commands until
+   *  #socketDirectLeave, so all other modem functions fail meanwhile.
+   *  \param socket the socket handle
+   *  \return true if successfully, false otherwise
+   */
+  bool socketDirectLink(int socket);
+
+  /** Leave the direct link mode with the escape sequence, this takes
+   *  twice the guard time #DL_GUARD_MS, received data that was not read
+   *  yet is dropped.
+   *  \param socket the socket handle
+   *  \return true if successfully, false otherwise
+   */
+  bool socketDirectLeave(int socket);
+
   // ----------------------------------------------------------------
   // SMS Short Message Service
   // ----------------------------------------------------------------
@@ -309,6 +508,53 @@ public:
    */
   int readFile(const char* filename, char* buf, int len);
 
+  // ----------------------------------------------------------------
+  // URC Unsolicited Result Codes
+  // ----------------------------------------------------------------
+
+  //! number of urc handlers that can be attached
+  #define URC_HANDLERS 6
+
+  /** Callback function for #urcAttach with void* as argument
+   *  \param buf the urc line including the framing
+   *  \param len the size of the line
+   *  \param param the optional argument passed to #urcAttach
+   */
+  typedef void (*_URCPTR)(const char* buf, int len, void* param);
+
+  /** Attach a handler for an unsolicited result code. The handler is
+   *  called with the modem locked from the context reading the modem,
+   *  it should be short and must not send commands. Responses of
+   *  commands with the same name (e.g. +CREG) are passed too.
+   *  \param prefix the name of the urc including the '+' e.g. "+UUSORD"
+   *  \param cb the handler
+   *  \param param the optional argument passed to the handler
+   *  \return true if successful, false if all handlers are in use
+   */
+  bool urcAttach(const char* prefix, _URCPTR cb, void* param = NULL);
+
+  /** template version of #urcAttach, see #waitFinalResp
+   */
+  template<class T>
+  inline bool urcAttach(const char* prefix,
+                        void (*cb)(const char* buf, int len, T* param),
+                        T* param)
+  {
+    return urcAttach(prefix, (_URCPTR)cb, (void*)param);
+  }
+
+  /** Detach a handler attached with #urcAttach
+   *  \param prefix the name of the urc
+   *  \param cb the handler
+   */
+  void urcDetach(const char* prefix, _URCPTR cb);
+
+  /** Process the unsolicited result codes received while no command is
+   *  running. Call this periodically when no urc thread is used
+   *  (see #MDMRtosUrc).
+   */
+  void urcPoll(void);
+
   // ----------------------------------------------------------------
   // DEBUG/DUMP status to standard out (printf)
   // ----------------------------------------------------------------
@@ -453,6 +699,83 @@ public:
     return waitFinalResp((_CALLBACKPTR)cb, (void*)param, timeout_ms);
   }
 
+  // ----------------------------------------------------------------
+  // Command Queue
+  // ----------------------------------------------------------------
+
+  //! number of commands that can be queued
+  #define CMD_QUEUE 4
+  //! maximum size of a queued command
+  #define CMD_SIZE 40
+
+  /** Completion function for #cmdSubmit
+   *  \param handle the handle returned by #cmdSubmit
+   *  \param result the result (RESP_OK, RESP_ERROR, ... or WAIT on timeout)
+   *  \param latency_ms the time from submitting to completion
+   *  \param param the optional argument passed to #cmdSubmit
+   */
+  typedef void (*_DONEPTR)(int handle, int result, int latency_ms, void* param);
+
+  //! Statistics of the command queue
+  typedef struct {
+    int depth;                //!< number of commands queued or running
+    int peak;                 //!< maximum depth
+    unsigned int done;        //!< number of commands completed
+    unsigned int failed;      //!< number of commands completed with an error or timeout
+    unsigned int latency;     //!< latency of the last command in ms (submitted to completed)
+    unsigned int latencyMax;  //!< maximum latency in ms
+    unsigned int latencySum;  //!< sum of the latencies in ms, divided by done the average
+  } CmdStats;
+
+  /** Queue a command, it is sent as soon as the modem is idle. The calling
+   *  thread does not wait, the intermediate responses are passed to the
+   *  callback cb and the result to done, both in the context that runs
+   *  the queue (see #cmdPoll and #MDMRtosUrc).
+   *  \param cb the optional callback function for the responses (see #waitFinalResp)
+   *  \param done the optional completion function
+   *  \param param the optional argument passed to cb and done
+   *  \param timeout_ms the timeout of the response
+   *  \param format the command, formated printf style including "\r\n"
+   *  \return a handle (see #cmdResult) or SOCKET_ERROR if the queue is full
+   */
+  int cmdSubmit(_CALLBACKPTR cb, _DONEPTR done, void* param,
+                int timeout_ms, const char* format, ...);
+
+  /** template version of #cmdSubmit, see #waitFinalResp
+   */
+  template<class T>
+  inline int cmdSubmit(int (*cb)(int type, const char* buf, int len, T* param),
+                       void (*done)(int handle, int result, int latency_ms, T* param),
+                       T* param, int timeout_ms, const char* format, ...)
+  {
+    va_list args;
+    va_start(args, format);
+    int handle = _cmdSubmit((_CALLBACKPTR)cb, (_DONEPTR)done, (void*)param,
+                            timeout_ms, format, args);
+    va_end(args);
+    return handle;
+  }
+
+  /** Get the result of a queued command
+   *  \param handle the handle returned by #cmdSubmit
+   *  \param latency_ms optional, the time from submitting to completion
+   *  \return WAIT while queued or running, the result when completed or
+   *          NOT_FOUND if the handle is unknown or was reused
+   */
+  int cmdResult(int handle, int* latency_ms = NULL);
+
+  /** Run the queued commands, the urc thread (see #MDMRtosUrc) does this,
+   *  otherwise call it periodically
+   */
+  void cmdPoll(void);
+
+  /** Get the statistics of the command queue
+   *  \param st the statistics, the current depth is filled in too
+   *  \param reset clear the counters and maximums
+   *  \return true if successful
+   */
+  bool cmdStats(CmdStats* st, bool reset = false);
+
 protected:
   /** Write bytes to the physical interface. This function should be
    *  implemented in a inherited class.
@@ -462,32 +785,118 @@ protected:
    */
   virtual int _send(const void* buf, int len) = 0;
 
-  /** Helper: Parse a line from the receiving buffered pipe
+  /** Read raw bytes from the physical interface, bypassing the parser.
+   *  This function should be implemented in a inherited class.
+   *  \param buf the buffer to read into
+   *  \param len size of the buffer
+   *  \return bytes read, 0 if nothing is available
+   */
+  virtual int _recv(void* buf, int len) = 0;
+
+  /** Get the number of raw bytes available from the physical interface.
+   *  This function should be implemented in a inherited class.
+   *  \return bytes available
+   */
+  virtual int _recvable(void) = 0;
+
+  /** Set the sink for the payload of the next socket read response, so it
+   *  is not copied through the line buffer, see #_getLine.
+   *  \param buf the sink, NULL to remove it
+   *  \param len the size of the sink
+   *  \return true if supported, false if the payload stays in the line
+   */
+  virtual bool _sink(char* buf, int len) { return false; }
+
+  //! Parsing state of #_getLine, kept between calls so data is scanned only once
+  typedef struct {
+    int ix;           //!< offset of the next byte to scan, all before is unknown data
+    int o;            //!< bytes of the pending response at ix parsed so far, 0 if none
+    int type;         //!< type of the pending response
+    const char* fmt;  //!< rest of the format of the pending response, NULL for a line
+    int num;          //!< the last %d of the format or the bytes left of a %c
+    int sub;          //!< progress inside a format element or matched chars of the line end
+    int hdr;          //!< bytes of the pending response before its %c payload
+    int pay;          //!< size of the %c payload of the pending response
+    char* dst;        //!< the sink for %c payloads, NULL if they stay in the response
+    int dstLen;       //!< the size of the sink
+    int cp;           //!< payload bytes moved to the sink, -1 if not streaming
+  } LexState;
+
+  /** Helper: Reset the parsing state, needed whenever data is removed from
+   *  the pipe other than by #_getLine. The sink is kept.
+   *  \param st the state to reset
+   */
+  static void _lexReset(LexState* st)
+  {
+    st->ix = st->o = st->type = st->num = st->sub = 0;
+    st->hdr = st->pay = 0;
+    st->cp = -1;
+    st->fmt = NULL;
+  }
+
+  /** Helper: Check if the pending response is inside a %c payload that
+   *  fits into the sink, it is then streamed into the sink.
+   *  \param st the parsing state
+   *  \return true if the payload can be streamed
+   */
+  static bool _lexSink(const LexState* st)
+  {
+    return st->dst && st->o && st->fmt && (st->fmt[0] == '%') && (st->fmt[1] == 'c') &&
+           (st->sub == 1) && (st->pay > 0) && (st->pay <= st->dstLen);
+  }
+
+  /** Helper: Parse a line from the receiving buffered pipe. If the state
+   *  has a sink, the payload of a +USORD, +USORF or +URDFILE response is
+   *  moved there straight from the pipe, as it arrives, and the line only
+   *  holds the response without it. The line buffer has to be the same
+   *  until such a response is returned.
    *  \param pipe the receiving buffer pipe
    *  \param buf the parsed line
    *  \param len the size of the parsed line
+   *  \param st the parsing state, continues where the last call stopped
    *  \return type and length if something was found,
    *          WAIT if not enough data is available
    *          NOT_FOUND if nothing was found
    */
-  static int _getLine(Pipe<char>* pipe, char* buffer, int length);
+  static int _getLine(Pipe<char>* pipe, char* buffer, int length, LexState* st);
 
-  /** Helper: Parse a match from the pipe
-   *  \param pipe the buffered pipe
-   *  \param number of bytes to parse at maximum,
-   *  \param sta the starting string, NULL if none
-   *  \param end the terminating string, NULL if none
-   *  \return size of parsed match
+  /** Helper: Continue streaming the payload of the pending response into
+   *  the sink of the state and complete the response.
+   *  \param pipe the receiving buffer pipe
+   *  \param buf the parsed line, already holding the response up to the payload
+   *  \param len the size of the parsed line
+   *  \param st the parsing state
+   *  \return type and length of the response without the payload,
+   *          WAIT if not enough data is available
    */
-  static int _parseMatch(Pipe<char>* pipe, int len, const char* sta, const char* end);
+  static int _lexStream(Pipe<char>* pipe, char* buf, int len, LexState* st);
 
-  /** Helper: Parse a match from the pipe
-   *  \param pipe the buffered pipe
-   *  \param number of bytes to parse at maximum,
-   *  \param fmt the formating string (%d any number, %c any char of last %d len)
-   *  \return size of parsed match
+  /** Helper: Classify the response starting at a line break. All the
+   *  keywords are matched in a single pass, formated responses and
+   *  lines are continued with #_lexRest.
+   *  \param pipe the receiving buffer pipe
+   *  \param ix the offset of the line break in the pipe
+   *  \param len number of bytes available starting at ix
+   *  \param wait if false an incomplete response is skipped and a
+   *          shorter match is tried instead (used when the pipe is full)
+   *  \param st the parsing state, holds the response pending at ix
+   *  \return type and length if something was found,
+   *          WAIT if not enough data is available
+   *          NOT_FOUND if nothing was found
    */
-  static int _parseFormated(Pipe<char>* pipe, int len, const char* fmt);
+  static int _lexLine(Pipe<char>* pipe, int ix, int len, bool wait, LexState* st);
+
+  /** Helper: Continue parsing the rest of a pending response, the format
+   *  (%d any number, %c any char of last %d len, %s a quoted string) or
+   *  a line of at least one char terminated by "\r\n".
+   *  \param pipe the buffered pipe, positioned after the parsed bytes
+   *  \param len number of bytes of the response available at maximum
+   *  \param st the parsing state, updated with the progress
+   *  \return size of parsed response,
+   *          WAIT if not enough data is available
+   *          NOT_FOUND if the data does not match the format
+   */
+  static int _lexRest(Pipe<char>* pipe, int len, LexState* st);
 
 protected:
   // for rtos over riding by using Rtos<MDMxx>
@@ -495,6 +904,35 @@ protected:
    *  \param ms the number of milliseconds to wait
    */
   virtual void wait_ms(int ms)   { if (ms) ::wait_ms(ms); }
+  /** wait until data for a urc may have been received, override in a
+   *  rtos system to sleep until the rx interrupt signals
+   *  \param ms the number of milliseconds to wait at maximum,
+   *          TIMEOUT_BLOCKING to wait without limit
+   */
+  virtual void urcWait(int ms)   { waitRx(ms); }
+  //! wake the urc thread, e.g. when a command was queued
+  virtual void urcWake(void)     { }
+  /** wait until a socket may have changed, override in a rtos system to
+   *  sleep until #pollWake or the rx interrupt signals
+   *  \param ms the number of milliseconds to wait at maximum,
+   *          TIMEOUT_BLOCKING to wait without limit
+   */
+  virtual void pollWait(int ms)  { waitRx(ms); }
+  //! wake the thread in #socketPoll, e.g. when a socket urc was handled
+  virtual void pollWake(void)    { }
+  /** wait until data for a socket read may have been received, called
+   *  without the lock, so a rtos system has to sleep on a signal of its
+   *  own, the thread holding the lock may wait in #waitRx meanwhile
+   *  \param ms the number of milliseconds to wait at maximum,
+   *          TIMEOUT_BLOCKING to wait without limit
+   */
+  virtual void readWait(int ms)  { waitRx(ms); }
+  /** wait until data is received, override in a rtos system to sleep
+   *  until the rx interrupt signals, otherwise the pipe is polled
+   *  \param ms the number of milliseconds to wait at maximum,
+   *          TIMEOUT_BLOCKING to wait without limit
+   */
+  virtual void waitRx(int ms)    { wait_ms(((ms < 0) || (ms > 10)) ? 10 : ms); }
   //! override the lock in a rtos system
   virtual void lock(void)        { }
   //! override the unlock in a rtos system
@@ -507,10 +945,13 @@ protected:
   static int _cbATI(int type, const char* buf, int len, Dev* dev);
   static int _cbCPIN(int type, const char* buf, int len, Sim* sim);
   static int _cbCCID(int type, const char* buf, int len, char* ccid);
+  typedef struct { int creg; Sim sim; char ccid[20+1]; } WarmParam;
+  static int _cbWarm(int type, const char* buf, int len, WarmParam* param);
   // network
   static int _cbCSQ(int type, const char* buf, int len, NetStatus* status);
   static int _cbCOPS(int type, const char* buf, int len, NetStatus* status);
   static int _cbCNUM(int type, const char* buf, int len, char* num);
+  static int _cbNet(int type, const char* buf, int len, NetStatus* status);
   static int _cbUACTIND(int type, const char* buf, int len, int* i);
   static int _cbUDOPN(int type, const char* buf, int len, char* mccmnc);
   // sockets
@@ -519,6 +960,7 @@ protected:
   static int _cbUPSND(int type, const char* buf, int len, IP* ip);
   static int _cbUDNSRN(int type, const char* buf, int len, IP* ip);
   static int _cbUSOCR(int type, const char* buf, int len, int* handle);
+  static int _cbCONNECT(int type, const char* buf, int len, void* param);
   static int _cbUSORD(int type, const char* buf, int len, char* out);
   typedef struct { char* buf; IP ip; int port; } USORFparam;
   static int _cbUSORF(int type, const char* buf, int len, USORFparam* param);
@@ -535,15 +977,57 @@ protected:
   // variables
   DevStatus   _dev; //!< collected device information
   NetStatus   _net; //!< collected network information
+  bool   _netValid; //!< _net is complete, #checkNetStatus succeeded
+  uint64_t _netTime; //!< #_clock of the last successful #checkNetStatus
   IP          _ip;  //!< assigned ip address
   // management struture for sockets
-  typedef struct { int handle; int timeout_ms; volatile bool connected; volatile int pending; } SockCtrl;
+  typedef struct { int handle; IpProtocol ipproto; int timeout_ms; volatile bool connected; volatile int pending; Pipe<char>* rx;
+                   Pipe<char>* tx; int txSize; int txDelay; uint32_t txTime; } SockCtrl;
   // LISA-C has 6 TCP and 6 UDP sockets
   // LISA-U and SARA-G have 7 sockets
   SockCtrl _sockets[12];
+  int _direct; //!< the socket in direct link mode, SOCKET_ERROR if none
   int _findSocket(int handle = SOCKET_ERROR/* = CREATE*/);
+  int _socketRead(int socket, char* buf, int len);
+  int _socketFetch(int socket);
+  int _socketGather(int socket, const char* buf, int len);
+  int _socketSendVec(int socket, IP ip, int port, const SocketVec* vec, int num);
+  bool _socketWrite(int socket, IP ip, int port, const SocketVec* vec, int num, int skip, int len);
+  int _socketFlush(int socket);
+  // the attached urc handlers
+  typedef struct { const char* prefix; int len; _URCPTR cb; void* param; } UrcCtrl;
+  UrcCtrl _urc[URC_HANDLERS];
+  void _handleUrc(const char* buf, int len);
+  // the command queue, _cmdW is the next handle, _cmdR the one running
+  typedef struct {
+    int handle; _CALLBACKPTR cb; _DONEPTR done; void* param; int timeout_ms;
+    uint32_t submitted; volatile int result; int latency; char cmd[CMD_SIZE];
+  } CmdCtrl;
+  CmdCtrl _cmd[CMD_QUEUE];
+  volatile int _cmdW;
+  volatile int _cmdR;
+  CmdStats _cmdStats;
+  // the domain names kept by gethostbyname, an empty host is unused
+  typedef struct { char host[DNS_NAME_SIZE]; IP ip; uint64_t time; } DnsCtrl;
+  DnsCtrl _dns[DNS_CACHE];
+  DnsStats _dnsStats;
+  void _dnsFlush(const char* host);
+  /** Get the time since the driver was constructed, unlike the us ticker
+   *  it does not wrap after 71 minutes
+   *  \return the time in ms
+   */
+  uint64_t _clock(void);
+  //! called by #_clockTicker to extend the clock before the us ticker wraps
+  void _clockTick(void) { _clock(); }
+  Ticker   _clockTicker; //!< extends the clock regularly, also while idle
+  uint64_t _clockMs;     //!< the clock in ms
+  uint32_t _clockRest;   //!< the us not yet added to the clock
+  uint32_t _clockLast;   //!< the us ticker the clock was extended at
+  int _cmdSubmit(_CALLBACKPTR cb, _DONEPTR done, void* param,
+                 int timeout_ms, const char* format, va_list args);
   static MDMParser* inst;
   bool _init;
+  bool _warm; //!< taken over by #initWarm, #join keeps the data profile
 #ifdef MDM_DEBUG
   int _debugLevel;
   Timer _debugTime;
@@ -565,11 +1049,13 @@ public:
    *  \param rx is the serial ports receive pin (CPU to modem)
    *  \param baudrate the baudrate of the modem use 115200
    *  \param rts is the serial ports ready to send pin (CPU to modem)
-   *          this pin is optional
+   *          this pin is optional, it is driven by the rx buffer fill level
    *  \param cts is the serial ports clear to send pin (modem to CPU)
    *          this pin is optional, but required for power saving to be enabled
    *  \param rxSize the size of the serial rx buffer
    *  \param txSize the size of the serial tx buffer
+   *  \param rxBuf optional serial rx buffer, allocated if NULL
+   *  \param txBuf optional serial tx buffer, allocated if NULL
    */
   MDMSerial(PinName tx = PA_2,
             PinName rx = PA_3,
@@ -579,7 +1065,9 @@ public:
             PinName cts = NC /* D3 resistor R63 on shield not mounted */,
 #endif
             int rxSize    = 256 ,
-            int txSize    = 128 );
+            int txSize    = 128 ,
+            char* rxBuf   = NULL,
+            char* txBuf   = NULL);
   //! Destructor
   virtual ~MDMSerial(void);
 
@@ -597,6 +1085,7 @@ public:
   {
     while (readable())
       getc();
+    _lexReset(&_lex);
   }
 protected:
   /** Write bytes to the physical interface.
@@ -605,6 +1094,50 @@ protected:
    *  \return bytes written
    */
   virtual int _send(const void* buf, int len);
+  /** Read raw bytes from the rx pipe.
+   *  \param buf the buffer to read into
+   *  \param len size of the buffer
+   *  \return bytes read
+   */
+  virtual int _recv(void* buf, int len);
+  //! \return the raw bytes available in the rx pipe
+  virtual int _recvable(void)         { return readable(); }
+  /** Set the payload sink of the rx pipe lexer.
+   *  \param buf the sink, NULL to remove it
+   *  \param len the size of the sink
+   *  \return true
+   */
+  virtual bool _sink(char* buf, int len);
+  LexState _lex; //!< parsing state of the rx pipe
+};
+
+// -----------------------------------------------------------------------
+
+/** Modem class which uses a serial port with statically sized buffers.
+ *  The buffers are part of the object, so no heap is used.
+ *  \tparam RXSIZE the size of the serial rx buffer (power of two)
+ *  \tparam TXSIZE the size of the serial tx buffer (power of two)
+ */
+template <int RXSIZE = 256, int TXSIZE = 128>
+class MDMSerialStatic : private SerialPipeStorage<RXSIZE, TXSIZE>, public MDMSerial
+{
+public:
+  /** Constructor, see #MDMSerial
+   */
+  MDMSerialStatic(PinName tx = PA_2,
+                  PinName rx = PA_3,
+#if DEVICE_SERIAL_FC
+                  int baudrate = 115200,
+                  PinName rts = NC,
+                  PinName cts = NC) :
+    MDMSerial(tx, rx, baudrate, rts, cts, RXSIZE, TXSIZE,
+              this->_rxStorage, this->_txStorage)
+#else
+                  int baudrate = 115200) :
+    MDMSerial(tx, rx, baudrate, RXSIZE, TXSIZE,
+              this->_rxStorage, this->_txStorage)
+#endif
+  { }
 };
 
 // -----------------------------------------------------------------------
@@ -622,6 +1155,8 @@ public:
   virtual void purge(void) { }
 protected:
   virtual int _send(const void* buf, int len);
+  virtual int _recv(void* buf, int len);
+  virtual int _recvable(void);
 };
 #endif
 
@@ -635,17 +1170,94 @@ protected:
 template <class T>
 class MDMRtos :  public T
 {
+public:
+  //! let the modem thread sleep while waiting on the serial port
+  MDMRtos(void) : _readSignal(0x0800), _pollSignal(0x1000, &_readSignal),
+                  _urcSignal(0x2000, &_pollSignal),
+                  _rxSignal(0x4000, &_urcSignal), _txSignal(0x8000)
+  {
+    T::attachSignals(&_rxSignal, &_txSignal);
+  }
+  //! detach the signals before they are destroyed
+  virtual ~MDMRtos(void)
+  {
+    T::attachSignals(NULL, NULL);
+  }
 protected:
   //! we assume that the modem runs in a thread so we yield when waiting
   virtual void wait_ms(int ms)   {
     if (ms) Thread::wait(ms);
     else    Thread::yield();
   }
+  //! sleep until the rx interrupt signals new data
+  virtual void waitRx(int ms)    { _rxSignal.wait(ms); }
+  //! sleep until the rx interrupt signals new data, in the urc thread
+  virtual void urcWait(int ms)   { _urcSignal.wait(ms); }
+  //! wake the urc thread
+  virtual void urcWake(void)     { _urcSignal.notify(); }
+  //! sleep until a socket urc was handled or new data arrived, in socketPoll
+  virtual void pollWait(int ms)  { _pollSignal.wait(ms); }
+  //! wake the thread in socketPoll
+  virtual void pollWake(void)    { _pollSignal.notify(); }
+  //! sleep until new data arrived, in socketRecv without the lock
+  virtual void readWait(int ms)  { _readSignal.wait(ms); }
   //! lock a mutex when accessing the modem
   virtual void lock(void)     { _mtx.lock(); }
   //! unlock the modem when done accessing it
   virtual void unlock(void)   { _mtx.unlock(); }
   // the mutex resource
   Mutex _mtx;
+  // signals from the rx/tx interrupts, rx also wakes the urc thread, the
+  // thread in socketPoll and the thread in socketRecv
+  PipeSignalRtos _readSignal;
+  PipeSignalRtos _pollSignal;
+  PipeSignalRtos _urcSignal;
+  PipeSignalRtos _rxSignal;
+  PipeSignalRtos _txSignal;
+};
+
+/** Use this template instead of #MDMRtos to process unsolicited result
+ *  codes in a thread of their own, as soon as they are received. The
+ *  thread sleeps until data arrives and then takes the modem lock, so it
+ *  never interferes with a command in progress. It also runs the
+ *  commands queued with #MDMParser::cmdSubmit, reads ahead the data
+ *  of the sockets with a receive buffer (#MDMParser::socketPrefetch) and
+ *  writes the send buffers that are due (#MDMParser::socketCoalesce).
+ *  \tparam STACK the size of the stack of the urc thread, a multiple of 8
+ */
+template <class T, int STACK = DEFAULT_STACK_SIZE>
+class MDMRtosUrc :  public MDMRtos<T>
+{
+public:
+  //! start the urc thread
+  MDMRtosUrc(osPriority priority = osPriorityNormal) :
+    _urcRun(true),
+    _urcThread(MDMRtosUrc::_urcFunc, this, priority, sizeof(_urcStack), (unsigned char*)_urcStack)
+  { }
+  //! stop the urc thread
+  virtual ~MDMRtosUrc(void)
+  {
+    _urcRun = false;
+    this->urcWake();
+  }
+protected:
+  //! the urc thread, processes the urcs until stopped
+  static void _urcFunc(void const* param)
+  {
+    MDMRtosUrc* that = (MDMRtosUrc*)param;
+    int due = PipeSignal::FOREVER;
+    while (that->_urcRun) {
+      that->urcWait(due);
+      if (that->_urcRun) {
+        that->cmdPoll();
+        that->urcPoll();
+        that->socketFetch();
+        due = that->socketFlushPoll();
+      }
+    }
+  }
+  volatile bool _urcRun;               //!< the urc thread runs
+  uint64_t      _urcStack[STACK/8];    //!< thread stack, not on the heap, 8 byte aligned
+  Thread        _urcThread;            //!< last, it runs as soon as it is constructed
 };
 #endif
@@ -1,25 +1,97 @@
 #pragma once
 
+#include <assert.h>
+
+//! collect statistics (throughput, peak fill level, overflows) of the pipes,
+//! build with -DPIPE_NO_STATS to compile the counters out
+#ifndef PIPE_NO_STATS
+#define PIPE_STATS
+#endif
+
+/** Statistics of a pipe, see #Pipe::stats
+ */
+typedef struct {
+  unsigned int in;      //!< number of elements added
+  unsigned int out;     //!< number of elements removed
+  unsigned int dropped; //!< number of elements the writer dropped (pipe full)
+  int          peak;    //!< highest fill level seen
+} PipeStats;
+
+/** PipeSignal, lets a context that is blocked on a pipe sleep until the
+ *  other side of the pipe made progress instead of spinning. The pipe
+ *  notifies the signal whenever data was added (reader signal) or space
+ *  was freed (writer signal). Notifications may come from an interrupt.
+ */
+class PipeSignal
+{
+public:
+  enum { FOREVER = -1 }; //!< timeout to wait without limit
+
+  //! Destructor
+  virtual ~PipeSignal(void) { }
+
+  /** Sleep until notified. A notification that happened since the last
+   *  wait must not be lost, spurious wake ups are allowed.
+   *  \param timeout_ms the time to wait, FOREVER to wait without limit
+   *  \return true if notified, false if timed out
+   */
+  virtual bool wait(int timeout_ms) = 0;
+
+  /** Wake up a waiting context (interrupt safe)
+   */
+  virtual void notify(void) = 0;
+};
+
 /** Pipe, this class implements a buffered pipe that can be savely
  *  written and read between two context. E.g. Written from a task
  *  and read from a interrupt.
+ *
+ *  The pipe is a single producer / single consumer ring buffer. The
+ *  write index is only modified by the writing context and the read
+ *  index only by the reading context. Both indexes are free running
+ *  and the capacity is a power of two, so wrapping is a simple mask
+ *  and all elements of the buffer can be used.
+ *
+ *  Pipe<T> uses a buffer that is allocated or passed at runtime,
+ *  Pipe<T, N> has a buffer of N elements inside the object.
+ */
+template <class T, int N = 0>
+class Pipe;
+
+/** Pipe with a buffer of a size known at runtime (see #Pipe)
  */
 template <class T>
-class Pipe
+class Pipe<T, 0>
 {
 public:
+  /** A contiguous region of elements inside the pipe buffer
+   */
+  typedef struct {
+    T*  p; //!< pointer to the first element
+    int n; //!< number of elements
+  } Span;
+
   /** Constructor
-   *  \param n size of the pipe/buffer
+   *  \param n size of the pipe/buffer, has to be a power of two, other
+   *          sizes are rejected and leave the pipe without a buffer
    *  \param b optional buffer that should be used.
    *          if NULL the constructor will allocate a buffer of size n.
    */
   Pipe(int n, T* b = NULL)
   {
-    _a = b ? NULL : n ? new T[n] : NULL;
+    assert((n >= 0) && !(n & (n - 1)));
+    int s = ((n > 0) && !(n & (n - 1))) ? n : 0;
+    _a = b ? NULL : s ? new T[s] : NULL;
     _r = 0;
     _w = 0;
+    _o = 0;
     _b = b ? b : _a;
-    _s = n;
+    _s = s;
+    _rs = NULL;
+    _ws = NULL;
+#ifdef PIPE_STATS
+    memset(&_st, 0, sizeof(_st));
+#endif
   }
   /** Destructor
    *  frees a allocated buffer.
@@ -35,16 +107,65 @@ public:
    */
   void dump(void)
   {
-    int o = _r;
+    unsigned int o = _r;
+    unsigned int w = _w;
     printf("pipe: %d/%d ", size(), _s);
-    while (o != _w) {
-      T t = _b[o];
+    while (o != w) {
+      T t = _b[o & (_s - 1)];
       printf("%0*X", sizeof(T)*2, t);
-      o = _inc(o);
+      o ++;
     }
     printf("\n");
   }
 
+  /** Get the capacity of the pipe
+   *  \return the number of elements that can be stored
+   */
+  int capacity(void)
+  {
+    return _s;
+  }
+
+  /** Attach signals used by the blocking functions. Without a signal
+   *  the blocking functions busy wait and do not apply a timeout.
+   *  \param rs the signal the reader sleeps on, notified when data was added
+   *  \param ws the signal the writer sleeps on, notified when space was freed
+   */
+  void signal(PipeSignal* rs, PipeSignal* ws)
+  {
+    _rs = rs;
+    _ws = ws;
+  }
+
+  /** Discard the content and restart the indexes at the start of the
+   *  buffer. Only call this while neither context is using the pipe.
+   */
+  void reset(void)
+  {
+    _r = 0;
+    _w = 0;
+    _o = 0;
+  }
+
+  /** Get the statistics of the pipe. The counters are updated by both
+   *  contexts, a reset may therefore miss updates made concurrently.
+   *  \param st the statistics
+   *  \param reset set to true to restart the counters
+   *  \return true if successful, false if compiled without PIPE_STATS
+   */
+  bool stats(PipeStats* st, bool reset = false)
+  {
+#ifdef PIPE_STATS
+    if (st)
+      memcpy(st, &_st, sizeof(_st));
+    if (reset)
+      memset(&_st, 0, sizeof(_st));
+    return true;
+#else
+    return false;
+#endif
+  }
+
   // writing thread/context API
   //-------------------------------------------------------------
 
@@ -61,10 +182,7 @@ public:
    */
   int free(void)
   {
-    int s = _r - _w;
-    if (s <= 0)
-      s += _s;
-    return s - 1;
+    return _s - (int)(_w - _r);
   }
 
   /** Add a single element to the buffer. (blocking)
@@ -73,13 +191,14 @@ public:
    */
   T putc(T c)
   {
-    int i = _w;
-    int j = i;
-    i = _inc(i);
-    while (i == _r) // = !writeable()
-      /* nothing / just wait */;
-    _b[j] = c;
-    _w = i;
+    unsigned int w = _w;
+    while ((int)(w - _r) >= _s) // = !writeable()
+      _wait(_ws, PipeSignal::FOREVER);
+    _b[w & (_s - 1)] = c;
+    _barrier();
+    _w = w + 1;
+    _statsIn(1);
+    if (_rs) _rs->notify();
     return c;
   }
 
@@ -87,35 +206,85 @@ public:
    *  \param p the elements to add
    *  \param n the number elements to add from p
    *  \param t set to true if blocking, false otherwise
+   *  \param timeout_ms the time to wait for space when blocking
    *  \return number elements added
    */
-  int put(const T* p, int n, bool t = false)
+  int put(const T* p, int n, bool t = false, int timeout_ms = PipeSignal::FOREVER)
   {
     int c = n;
     while (c)
     {
+      Span s[2];
       int f;
       for (;;) // wait for space
       {
-        f = free();
-        if (f > 0) break;     // data avail
+        f = writeSpans(s);
+        if (f > 0) break;     // space avail
         if (!t) return n - c; // no more space and not blocking
-          /* nothing / just wait */;
+        if (!_wait(_ws, timeout_ms) && !writeable())
+          return n - c;       // timed out
+      }
+      // copy into the (up to two) free regions
+      int m = 0;
+      for (int i = 0; (i < 2) && c; i ++) {
+        int k = (c < s[i].n) ? c : s[i].n;
+        memcpy(s[i].p, p, k * sizeof(T));
+        p += k;
+        c -= k;
+        m += k;
       }
-      // check free space
-      if (c < f) f = c;
-      int w = _w;
-      int m = _s - w;
-      // check wrap
-      if (f > m) f = m;
-      memcpy(&_b[w], p, f);
-      _w = _inc(w, f);
-      c -= f;
-      p += f;
+      writeCommit(m);
     }
     return n - c;
   }
 
+  /** Get the free regions of the buffer for writing in place. The free
+   *  space may wrap at the end of the buffer, therefore up to two
+   *  contiguous regions are returned. Elements written to the regions
+   *  become visible to the reader after calling #writeCommit.
+   *  \param s array of two spans receiving the free regions
+   *  \return the total number of free elements
+   */
+  int writeSpans(Span s[2])
+  {
+    unsigned int w = _w;
+    return _spans(w, _s - (int)(w - _r), s);
+  }
+
+  /** Publish elements written in place to the free regions.
+   *  \param n the number of elements written
+   */
+  void writeCommit(int n)
+  {
+    _barrier();
+    _w = _w + n;
+    _statsIn(n);
+    if (_rs) _rs->notify();
+  }
+
+  /** Account elements the writer had to drop because the pipe was full
+   *  \param n the number of elements dropped
+   */
+  void drop(int n)
+  {
+#ifdef PIPE_STATS
+    _st.dropped += n;
+#endif
+  }
+
+  /** Wait until the buffer is writeable
+   *  \param timeout_ms the time to wait, FOREVER to wait without limit
+   *  \return true if writeable
+   */
+  bool waitWriteable(int timeout_ms = PipeSignal::FOREVER)
+  {
+    while (!writeable()) {
+      if (!_wait(_ws, timeout_ms))
+        return writeable();
+    }
+    return true;
+  }
+
   // reading thread/context API
   // --------------------------------------------------------
 
@@ -132,10 +301,7 @@ public:
   */
   int size(void)
   {
-    int s = _w - _r;
-    if (s < 0)
-      s += _s;
-    return s;
+    return (int)(_w - _r);
   }
 
   /** Get a single value from buffered pipe (this function will block if no values available)
@@ -143,11 +309,15 @@ public:
    */
   T getc(void)
   {
-    int r = _r;
+    unsigned int r = _r;
     while (r == _w) // = !readable()
-      /* nothing / just wait */;
-    T t = _b[r];
-    _r = _inc(r);
+      _wait(_rs, PipeSignal::FOREVER);
+    _barrier();
+    T t = _b[r & (_s - 1)];
+    _barrier();
+    _r = r + 1;
+    _statsOut(1);
+    if (_ws) _ws->notify();
     return t;
   }
 
@@ -155,35 +325,78 @@ public:
    *  \param p the elements extracted
    *  \param n the maximum number elements to extract
    *  \param t set to true if blocking, false otherwise
+   *  \param timeout_ms the time to wait for data when blocking
    *  \return number elements extracted
    */
-  int get(T* p, int n, bool t = false)
+  int get(T* p, int n, bool t = false, int timeout_ms = PipeSignal::FOREVER)
   {
     int c = n;
     while (c)
     {
+      Span s[2];
       int f;
       for (;;) // wait for data
       {
-        f = size();
-        if (f)  break;        // free space
-        if (!t) return n - c; // no space and not blocking
-        /* nothing / just wait */;
+        f = readSpans(s);
+        if (f)  break;        // data avail
+        if (!t) return n - c; // no data and not blocking
+        if (!_wait(_rs, timeout_ms) && !readable())
+          return n - c;       // timed out
       }
-      // check available data
-      if (c < f) f = c;
-      int r = _r;
-      int m = _s - r;
-      // check wrap
-      if (f > m) f = m;
-      memcpy(p, &_b[r], f);
-      _r = _inc(r, f);
-      c -= f;
-      p += f;
+      // copy from the (up to two) filled regions
+      int m = 0;
+      for (int i = 0; (i < 2) && c; i ++) {
+        int k = (c < s[i].n) ? c : s[i].n;
+        memcpy(p, s[i].p, k * sizeof(T));
+        p += k;
+        c -= k;
+        m += k;
+      }
+      readCommit(m);
     }
     return n - c;
   }
 
+  /** Get the filled regions of the buffer for reading in place. The data
+   *  may wrap at the end of the buffer, therefore up to two contiguous
+   *  regions are returned. The elements are released with #readCommit.
+   *  \param s array of two spans receiving the filled regions
+   *  \param ix optional offset from the read index
+   *  \return the total number of elements available after ix
+   */
+  int readSpans(Span s[2], int ix = 0)
+  {
+    unsigned int r = _r;
+    int sz = (int)(_w - r);
+    _barrier();
+    ix = (ix > sz) ? sz : ix;
+    return _spans(r + ix, sz - ix, s);
+  }
+
+  /** Release elements read in place from the filled regions.
+   *  \param n the number of elements consumed
+   */
+  void readCommit(int n)
+  {
+    _barrier();
+    _r = _r + n;
+    _statsOut(n);
+    if (_ws) _ws->notify();
+  }
+
+  /** Wait until the buffer is readable
+   *  \param timeout_ms the time to wait, FOREVER to wait without limit
+   *  \return true if readable
+   */
+  bool waitReadable(int timeout_ms = PipeSignal::FOREVER)
+  {
+    while (!readable()) {
+      if (!_wait(_rs, timeout_ms))
+        return readable();
+    }
+    return true;
+  }
+
   // the following functions are useful if you like to inspect
   // or parse the buffer in the reading thread/context
   // --------------------------------------------------------
@@ -196,8 +409,9 @@ public:
   int set(int ix)
   {
     int sz = size();
+    _barrier();
     ix = (ix > sz) ? sz : ix;
-    _o = _inc(_r, ix);
+    _o = _r + ix;
     return sz - ix;
   }
 
@@ -206,37 +420,181 @@ public:
    */
   T next(void)
   {
-    int o = _o;
-    T t = _b[o];
-    _o = _inc(o);
-    return t;
+    return _b[(_o ++) & (_s - 1)];
   }
 
   /** Commit the index, mark the current parsing index as consumed data.
    */
   void done(void)
   {
+    _barrier();
+    _statsOut((int)(_o - _r));
     _r = _o;
+    if (_ws) _ws->notify();
   }
 
 private:
-  /** Increment the index
-   *  \param i index to increment
-   *  \param n the step to increment
-   *  \return the incremented index.
+  /** Split a range of the ring into contiguous regions
+   *  \param i the (free running) index of the first element
+   *  \param n the number of elements in the range
+   *  \param s array of two spans receiving the regions
+   *  \return n
    */
-  inline int _inc(int i, int n = 1)
+  inline int _spans(unsigned int i, int n, Span s[2])
+  {
+    if (n <= 0) {
+      s[0].p = s[1].p = _b;
+      s[0].n = s[1].n = 0;
+      return 0;
+    }
+    int o = i & (_s - 1);
+    int m = _s - o;
+    if (n < m) m = n;
+    s[0].p = _b + o;
+    s[0].n = m;
+    s[1].p = _b;
+    s[1].n = n - m;
+    return n;
+  }
+
+  /** Let the calling context sleep on a signal (or spin without one)
+   *  \param sig the signal to wait on, may be NULL
+   *  \param timeout_ms the time to wait
+   *  \return false if the timeout expired
+   */
+  static inline bool _wait(PipeSignal* sig, int timeout_ms)
+  {
+    if (timeout_ms == 0)
+      return false;
+    if (sig)
+      return sig->wait(timeout_ms);
+    /* nothing / just wait */;
+    return true;
+  }
+
+  /** Account added elements and track the fill level
+   *  \param n the number of elements added
+   */
+  inline void _statsIn(int n)
+  {
+#ifdef PIPE_STATS
+    int sz = (int)(_w - _r);
+    _st.in += n;
+    if (sz > _st.peak)
+      _st.peak = sz;
+#endif
+  }
+
+  /** Account removed elements
+   *  \param n the number of elements removed
+   */
+  inline void _statsOut(int n)
+  {
+#ifdef PIPE_STATS
+    _st.out += n;
+#endif
+  }
+
+  /** Memory barrier, orders the buffer accesses against the update of
+   *  the indexes, which are observed by the other context.
+   */
+  static inline void _barrier(void)
+  {
+    __sync_synchronize();
+  }
+
+  T*                    _b; //!< buffer
+  T*                    _a; //!< allocated buffer
+  int                   _s; //!< size of buffer (power of two)
+  volatile unsigned int _w; //!< write index (free running)
+  volatile unsigned int _r; //!< read index (free running)
+  unsigned int          _o; //!< offest index used by parsing functions
+  PipeSignal*           _rs; //!< signal the reader sleeps on
+  PipeSignal*           _ws; //!< signal the writer sleeps on
+#ifdef PIPE_STATS
+  PipeStats             _st; //!< statistics
+#endif
+private:
+  // the pipe owns its buffer, do not copy
+  Pipe(const Pipe&);
+  Pipe& operator=(const Pipe&);
+};
+
+/** Storage for a statically sized pipe. This is a separate base class so
+ *  that the storage is constructed before the pipe that is using it.
+ */
+template <class T, int N>
+class PipeStorage
+{
+protected:
+  //! the size has to be a power of two
+  typedef char _checkSize[((N > 0) && !(N & (N - 1))) ? 1 : -1];
+  T _storage[N]; //!< the buffer
+};
+
+/** Pipe with a buffer of N elements inside the object, so no heap is
+ *  used and a global or static pipe shows up in the link map.
+ *  \tparam T the type of the elements
+ *  \tparam N the capacity, has to be a power of two
+ */
+template <class T, int N>
+class Pipe : private PipeStorage<T, N>, public Pipe<T, 0>
+{
+public:
+  //! Constructor
+  Pipe(void) : Pipe<T, 0>(N, this->_storage) { }
+};
+
+#ifdef RTOS_H
+/** Use this signal to let a thread sleep while it is blocked on a pipe.
+ *  It uses a thread signal flag, which can be set from an interrupt.
+ *  Only one thread may wait on a signal at a time.
+ */
+class PipeSignalRtos : public PipeSignal
+{
+public:
+  /** Constructor
+   *  \param flag the thread signal flag used, choose one that is not
+   *          used otherwise by the waiting thread.
+   *  \param next optional signal that is notified together with this one,
+   *          so a second thread can wait for the same event
+   */
+  PipeSignalRtos(int32_t flag = 0x8000, PipeSignal* next = NULL)
+  {
+    _flag = flag;
+    _next = next;
+    _tid = NULL;
+    _pending = false;
+  }
+
+  virtual bool wait(int timeout_ms)
+  {
+    _tid = osThreadGetId();
+    bool ok = _pending;
+    if (!ok) {
+      osEvent evt = Thread::signal_wait(_flag,
+            (timeout_ms == FOREVER) ? osWaitForever : (uint32_t)timeout_ms);
+      ok = (evt.status == osEventSignal);
+    }
+    _tid = NULL;
+    _pending = false;
+    return ok;
+  }
+
+  virtual void notify(void)
   {
-    i += n;
-    if (i >= _s)
-      i -= _s;
-    return i;
+    _pending = true;
+    osThreadId tid = _tid;
+    if (tid)
+      osSignalSet(tid, _flag);
+    if (_next)
+      _next->notify();
   }
 
-  T*            _b; //!< buffer
-  T*            _a; //!< allocated buffer
-  int           _s; //!< size of buffer (s - 1) elements can be stored
-  volatile int  _w; //!< write index
-  volatile int  _r; //!< read index
-  int           _o; //!< offest index used by parsing functions
+protected:
+  int32_t             _flag;    //!< the thread signal flag
+  PipeSignal*         _next;    //!< notified together with this signal
+  volatile osThreadId _tid;     //!< the waiting thread
+  volatile bool       _pending; //!< notified since the last wait
 };
+#endif
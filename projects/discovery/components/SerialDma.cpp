@@ -0,0 +1,155 @@
+#include "mbed.h"
+#include "SerialDma.h"
+
+#ifdef TARGET_STM32L0
+
+#define DMA_REQ_USART2  4 //!< DMA request mapping of USART2 (channel 4..7)
+
+SerialDmaSTM32L0* SerialDmaSTM32L0::_inst;
+
+SerialDmaSTM32L0::SerialDmaSTM32L0(void)
+{
+  _inst = this;
+  _rxLen = 0;
+  _rxLaps = 0;
+  _usartVector = 0;
+  _rxHandler = NULL;
+  _rxParam = NULL;
+  _txHandler = NULL;
+  _txParam = NULL;
+}
+
+void SerialDmaSTM32L0::_dmaEnable(void)
+{
+  RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+  NVIC_SetVector(DMA1_Channel4_5_6_7_IRQn, (uint32_t)&_dmaIrq);
+  NVIC_EnableIRQ(DMA1_Channel4_5_6_7_IRQn);
+}
+
+SerialDmaSTM32L0::~SerialDmaSTM32L0(void)
+{
+  rxStop();
+  DMA1_Channel4->CCR &= ~DMA_CCR_EN;
+  USART2->CR3 &= ~USART_CR3_DMAT;
+  _inst = NULL;
+}
+
+bool SerialDmaSTM32L0::rxStart(char* buf, int len, Handler handler, void* param)
+{
+  if (!buf || (len <= 0) || (len > 0xFFFF))
+    return false;
+  _rxLen = len;
+  _rxLaps = 0;
+  _rxHandler = handler;
+  _rxParam = param;
+  _dmaEnable();
+  // channel 5: USART2 RDR -> memory, byte wise, circular
+  DMA1_Channel5->CCR &= ~DMA_CCR_EN;
+  DMA1_CSELR->CSELR = (DMA1_CSELR->CSELR & ~DMA_CSELR_C5S) | (DMA_REQ_USART2 << 16);
+  DMA1_Channel5->CPAR  = (uint32_t)&USART2->RDR;
+  DMA1_Channel5->CMAR  = (uint32_t)buf;
+  DMA1_Channel5->CNDTR = len;
+  DMA1_Channel5->CCR   = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_HTIE | DMA_CCR_TCIE;
+  DMA1->IFCR = DMA_IFCR_CGIF5;
+  DMA1_Channel5->CCR  |= DMA_CCR_EN;
+  // usart: request dma on receive, interrupt on idle line and errors only
+  USART2->ICR  = USART_ICR_IDLECF | USART_ICR_ORECF | USART_ICR_FECF | USART_ICR_NCF;
+  USART2->CR3 |= USART_CR3_DMAR | USART_CR3_EIE;
+  USART2->CR1  = (USART2->CR1 & ~USART_CR1_RXNEIE) | USART_CR1_IDLEIE;
+  // keep the serial driver's vector, rxStop puts it back
+  if (!_usartVector)
+    _usartVector = NVIC_GetVector(USART2_IRQn);
+  NVIC_SetVector(USART2_IRQn, (uint32_t)&_usartIrq);
+  NVIC_EnableIRQ(USART2_IRQn);
+  return true;
+}
+
+void SerialDmaSTM32L0::rxStop(void)
+{
+  USART2->CR1 &= ~USART_CR1_IDLEIE;
+  USART2->CR3 &= ~(USART_CR3_DMAR | USART_CR3_EIE);
+  DMA1_Channel5->CCR &= ~DMA_CCR_EN;
+  _rxHandler = NULL;
+  if (_usartVector) {
+    // a fall back to the interrupt driven serial port needs its vector
+    NVIC_SetVector(USART2_IRQn, _usartVector);
+    _usartVector = 0;
+  }
+}
+
+unsigned int SerialDmaSTM32L0::rxCount(void)
+{
+  __disable_irq();
+  unsigned int laps = _rxLaps;
+  int left = (int)DMA1_Channel5->CNDTR;
+  if (DMA1->ISR & DMA_ISR_TCIF5) {
+    // wrapped, but the interrupt that counts it is still pending
+    laps ++;
+    left = (int)DMA1_Channel5->CNDTR;
+  }
+  __enable_irq();
+  int pos = _rxLen - left;
+  if (pos >= _rxLen)
+    pos = 0;
+  return laps * _rxLen + pos;
+}
+
+bool SerialDmaSTM32L0::txStart(const char* buf, int len, Handler handler, void* param)
+{
+  if (!buf || (len <= 0) || (len > 0xFFFF) || txBusy())
+    return false;
+  _txHandler = handler;
+  _txParam = param;
+  _dmaEnable();
+  // channel 4: memory -> USART2 TDR, byte wise, single block
+  DMA1_CSELR->CSELR = (DMA1_CSELR->CSELR & ~DMA_CSELR_C4S) | (DMA_REQ_USART2 << 12);
+  DMA1_Channel4->CPAR  = (uint32_t)&USART2->TDR;
+  DMA1_Channel4->CMAR  = (uint32_t)buf;
+  DMA1_Channel4->CNDTR = len;
+  DMA1_Channel4->CCR   = DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_TCIE;
+  DMA1->IFCR = DMA_IFCR_CGIF4;
+  USART2->CR3 |= USART_CR3_DMAT;
+  DMA1_Channel4->CCR  |= DMA_CCR_EN;
+  return true;
+}
+
+bool SerialDmaSTM32L0::txBusy(void)
+{
+  return (DMA1_Channel4->CCR & DMA_CCR_EN) != 0;
+}
+
+void SerialDmaSTM32L0::_usartIrq(void)
+{
+  uint32_t isr = USART2->ISR;
+  // errors, the data is still moved by the dma
+  if (isr & (USART_ISR_ORE | USART_ISR_FE | USART_ISR_NE))
+    USART2->ICR = USART_ICR_ORECF | USART_ICR_FECF | USART_ICR_NCF;
+  if (isr & USART_ISR_IDLE) {
+    USART2->ICR = USART_ICR_IDLECF;
+    if (_inst && _inst->_rxHandler)
+      _inst->_rxHandler(_inst->_rxParam);
+  }
+}
+
+void SerialDmaSTM32L0::_dmaIrq(void)
+{
+  uint32_t isr = DMA1->ISR;
+  if (isr & DMA_ISR_TCIF4) {
+    // the block is in the usart, the buffer can be reused
+    DMA1->IFCR = DMA_IFCR_CGIF4;
+    DMA1_Channel4->CCR &= ~DMA_CCR_EN;
+    if (_inst && _inst->_txHandler)
+      _inst->_txHandler(_inst->_txParam);
+  }
+  if (isr & (DMA_ISR_HTIF5 | DMA_ISR_TCIF5)) {
+    if (_inst && (isr & DMA_ISR_TCIF5))
+      _inst->_rxLaps ++;
+    // clear only the flags seen, a wrap meanwhile has to stay pending
+    DMA1->IFCR = ((isr & DMA_ISR_HTIF5) ? DMA_IFCR_CHTIF5 : 0) |
+                 ((isr & DMA_ISR_TCIF5) ? DMA_IFCR_CTCIF5 : 0);
+    if (_inst && _inst->_rxHandler)
+      _inst->_rxHandler(_inst->_rxParam);
+  }
+}
+
+#endif
@@ -0,0 +1,209 @@
+#pragma once
+
+/** Backend that moves the data of a serial port with DMA, see
+ *  #SerialPipe::rxDma and #SerialPipe::txDma. The receiver writes
+ *  circularly into a buffer and calls a handler whenever the line went
+ *  idle or the transfer passed the middle or the end of the buffer. The
+ *  transmitter sends a contiguous block and calls a handler when done.
+ */
+class SerialDma
+{
+public:
+  /** Handler called by the backend (interrupt context)
+   *  \param param the parameter passed when starting
+   */
+  typedef void (*Handler)(void* param);
+
+  //! Destructor
+  virtual ~SerialDma(void) { }
+
+  /** Start receiving circularly into a buffer
+   *  \param buf the buffer to receive into
+   *  \param len the size of the buffer
+   *  \param handler called on idle line, half and full buffer
+   *  \param param passed to the handler
+   *  \return true if successful
+   */
+  virtual bool rxStart(char* buf, int len, Handler handler, void* param) = 0;
+
+  /** Stop receiving
+   */
+  virtual void rxStop(void) = 0;
+
+  /** Get the number of bytes received since the start, it keeps
+   *  counting over the laps of the circular buffer, so data that was
+   *  overwritten before it could be published is visible to the caller.
+   *  \return the number of bytes received (free running)
+   */
+  virtual unsigned int rxCount(void) = 0;
+
+  /** Start transmitting a block, the buffer has to stay valid until
+   *  the handler was called.
+   *  \param buf the data to send
+   *  \param len the size of the data
+   *  \param handler called when the block was transferred
+   *  \param param passed to the handler
+   *  \return true if successful
+   */
+  virtual bool txStart(const char* buf, int len, Handler handler, void* param) = 0;
+
+  /** Check if a transmission is in progress
+   *  \return true if busy
+   */
+  virtual bool txBusy(void) = 0;
+};
+
+#ifdef TARGET_STM32L0
+/** DMA backend for USART2 of the STM32L0, uses DMA1 channel 5 for
+ *  receiving and channel 4 for transmitting. It takes over the USART2
+ *  interrupt vector while receiving, so the serial port has to use the
+ *  backend for all interrupt driven transfers, #rxStop gives it back.
+ */
+class SerialDmaSTM32L0 : public SerialDma
+{
+public:
+  //! Constructor
+  SerialDmaSTM32L0(void);
+  //! Destructor
+  virtual ~SerialDmaSTM32L0(void);
+
+  virtual bool rxStart(char* buf, int len, Handler handler, void* param);
+  virtual void rxStop(void);
+  virtual unsigned int rxCount(void);
+  virtual bool txStart(const char* buf, int len, Handler handler, void* param);
+  virtual bool txBusy(void);
+
+protected:
+  //! enable the DMA controller and its interrupt
+  void _dmaEnable(void);
+  //! USART2 interrupt (idle line, errors)
+  static void _usartIrq(void);
+  //! DMA1 channel 4..7 interrupt (half and full buffer, transmit done)
+  static void _dmaIrq(void);
+  static SerialDmaSTM32L0* _inst; //!< the instance served by the interrupts
+  int          _rxLen;       //!< size of the receive buffer
+  volatile unsigned int _rxLaps; //!< number of times the receive buffer wrapped
+  uint32_t     _usartVector; //!< the USART2 vector before it was taken over, 0 if not
+  Handler      _rxHandler;   //!< receive handler
+  void*        _rxParam;     //!< receive handler parameter
+  Handler      _txHandler;   //!< transmit handler
+  void*        _txParam;     //!< transmit handler parameter
+};
+#endif
+
+/** Fake DMA backend, it can be used on a host (Linux) to test the DMA
+ *  handling of #SerialPipe without hardware. Received data is injected
+ *  with #receive and an idle line with #idle, a pending transmission is
+ *  completed with #transmit.
+ */
+class SerialDmaFake : public SerialDma
+{
+public:
+  //! Constructor
+  SerialDmaFake(void)
+  {
+    _rxBuf = NULL;
+    _rxLen = 0;
+    _rxPos = 0;
+    _rxCnt = 0;
+    _rxHandler = NULL;
+    _rxParam = NULL;
+    _txBuf = NULL;
+    _txLen = 0;
+    _txHandler = NULL;
+    _txParam = NULL;
+  }
+
+  virtual bool rxStart(char* buf, int len, Handler handler, void* param)
+  {
+    _rxBuf = buf;
+    _rxLen = len;
+    _rxPos = 0;
+    _rxCnt = 0;
+    _rxHandler = handler;
+    _rxParam = param;
+    return (buf != NULL) && (len > 0);
+  }
+
+  virtual void rxStop(void)
+  {
+    _rxBuf = NULL;
+  }
+
+  virtual unsigned int rxCount(void)
+  {
+    return _rxCnt;
+  }
+
+  virtual bool txStart(const char* buf, int len, Handler handler, void* param)
+  {
+    if (!buf || (len <= 0) || _txBuf)
+      return false;
+    _txBuf = buf;
+    _txLen = len;
+    _txHandler = handler;
+    _txParam = param;
+    return true;
+  }
+
+  virtual bool txBusy(void)
+  {
+    return _txBuf != NULL;
+  }
+
+  /** Write data to the buffer like the DMA controller would, the handler
+   *  is called when passing the middle and the end of the buffer.
+   *  \param buf the received data
+   *  \param len the size of the received data
+   *  \param notify false to lose the handler calls, like a late interrupt
+   */
+  void receive(const char* buf, int len, bool notify = true)
+  {
+    while (_rxBuf && (len --)) {
+      _rxBuf[_rxPos] = *buf++;
+      _rxPos = (_rxPos + 1) % _rxLen;
+      _rxCnt ++;
+      if (notify && ((_rxPos == 0) || (_rxPos == _rxLen / 2)))
+        idle();
+    }
+  }
+
+  /** Signal an idle line to the receiver
+   */
+  void idle(void)
+  {
+    if (_rxBuf && _rxHandler)
+      _rxHandler(_rxParam);
+  }
+
+  /** Complete the pending transmission like the DMA controller would
+   *  \param buf receives the transmitted data, may be NULL
+   *  \param len the size of buf
+   *  \return the number of bytes transmitted
+   */
+  int transmit(char* buf, int len)
+  {
+    const char* p = _txBuf;
+    int n = _txLen;
+    if (!p)
+      return 0;
+    if (buf)
+      memcpy(buf, p, (n < len) ? n : len);
+    _txBuf = NULL;
+    if (_txHandler)
+      _txHandler(_txParam);
+    return n;
+  }
+
+protected:
+  char*   _rxBuf;     //!< receive buffer
+  int     _rxLen;     //!< size of the receive buffer
+  int     _rxPos;     //!< receive position
+  unsigned int _rxCnt; //!< bytes received since the start
+  Handler _rxHandler; //!< receive handler
+  void*   _rxParam;   //!< receive handler parameter
+  const char* _txBuf; //!< block being transmitted, NULL if idle
+  int     _txLen;     //!< size of the block being transmitted
+  Handler _txHandler; //!< transmit handler
+  void*   _txParam;   //!< transmit handler parameter
+};
@@ -1,20 +1,101 @@
 #include "SerialPipe.h"
 
-SerialPipe::SerialPipe(PinName tx, PinName rx, int rxSize, int txSize) :
+SerialPipe::SerialPipe(PinName tx, PinName rx, int rxSize, int txSize,
+                       char* rxBuf, char* txBuf) :
 _SerialPipeBase(tx,rx),
-_pipeRx( (rx!=NC) ? rxSize : 0),
-_pipeTx( (tx!=NC) ? txSize : 0)
+_pipeRx( (rx!=NC) ? rxSize : 0, rxBuf),
+_pipeTx( (tx!=NC) ? txSize : 0, txBuf),
+_rxFlowSignal(this)
 {
+#ifdef PIPE_STATS
+  _rxIrq = 0;
+  _txIrq = 0;
+  _rxStop = 0;
+#endif
+  _rxFlowHigh = 0;
+  _rxFlowLow = 0;
+  _rxFlowStopped = false;
+  _rxDma = NULL;
+  _rxDmaCnt = 0;
+  _rxDmaLag = 0;
+  _txDma = NULL;
+  _txDmaLen = 0;
+  _pipeRx.signal(NULL, &_rxFlowSignal);
   if (rx!=NC)
     attach(this, &SerialPipe::rxIrqBuf, RxIrq);
 }
 
 SerialPipe::~SerialPipe(void)
 {
+  if (_rxDma)
+    _rxDma->rxStop();
   attach(NULL, RxIrq);
   attach(NULL, TxIrq);
 }
 
+void SerialPipe::attachSignals(PipeSignal* rx, PipeSignal* tx)
+{
+  _pipeRx.signal(rx, &_rxFlowSignal);
+  _pipeTx.signal(NULL, tx);
+}
+
+void SerialPipe::rxFlow(PinName rts, int high, int low)
+{
+  _rxFlowHigh = 0;
+  if (rts != NC) {
+    gpio_init_out(&_rxRts, rts);
+    gpio_write(&_rxRts, 0);
+    _rxFlowStopped = false;
+    _rxFlowLow = low;
+    _rxFlowHigh = (high > 0) ? high : 1;
+  }
+}
+
+void SerialPipe::rxFlowStop(void)
+{
+  if (_rxFlowHigh && !_rxFlowStopped && (_pipeRx.size() >= _rxFlowHigh)) {
+    _rxFlowStopped = true;
+    gpio_write(&_rxRts, 1);
+#ifdef PIPE_STATS
+    _rxStop ++;
+#endif
+  }
+}
+
+void SerialPipe::rxFlowResume(void)
+{
+  if (_rxFlowStopped && (_pipeRx.size() <= _rxFlowLow)) {
+    // keep the receive interrupt from stopping in between
+    __disable_irq();
+    if (_rxFlowStopped) {
+      _rxFlowStopped = false;
+      gpio_write(&_rxRts, 0);
+    }
+    __enable_irq();
+  }
+}
+
+bool SerialPipe::stats(Stats* st, bool reset)
+{
+#ifdef PIPE_STATS
+  if (st) {
+    st->rxIrq = _rxIrq;
+    st->txIrq = _txIrq;
+    st->rxStop = _rxStop;
+  }
+  if (reset) {
+    _rxIrq = 0;
+    _txIrq = 0;
+    _rxStop = 0;
+  }
+  _pipeRx.stats(st ? &st->rx : NULL, reset);
+  _pipeTx.stats(st ? &st->tx : NULL, reset);
+  return true;
+#else
+  return false;
+#endif
+}
+
 // tx channel
 int SerialPipe::writeable(void)
 {
@@ -28,7 +109,7 @@ int SerialPipe::putc(int c)
   return c;
 }
 
-int SerialPipe::put(const void* buffer, int length, bool blocking)
+int SerialPipe::put(const void* buffer, int length, bool blocking, int timeout_ms)
 {
   int count = length;
   const char* ptr = (const char*)buffer;
@@ -44,7 +125,9 @@ int SerialPipe::put(const void* buffer, int length, bool blocking)
       }
       else if (!blocking)
         break;
-      /* nothing / just wait */;
+      // sleep until the tx isr made some space
+      else if (!_pipeTx.waitWriteable(timeout_ms))
+        break;
     }
     while (count);
   }
@@ -53,15 +136,29 @@ int SerialPipe::put(const void* buffer, int length, bool blocking)
 
 void SerialPipe::txCopy(void)
 {
-  while (_SerialPipeBase::writeable() && _pipeTx.readable())
+  Pipe<char>::Span s[2];
+  int n = 0;
+  _pipeTx.readSpans(s);
+  // feed the hardware directly from the pipe, release once at the end
+  for (int i = 0; i < 2; i ++)
   {
-    char c = _pipeTx.getc();
-    _SerialPipeBase::_base_putc(c);
+    const char* p = s[i].p;
+    const char* e = p + s[i].n;
+    while ((p < e) && _SerialPipeBase::writeable())
+      _SerialPipeBase::_base_putc(*p++);
+    n += p - s[i].p;
+    if (p < e)
+      break;
   }
+  if (n)
+    _pipeTx.readCommit(n);
 }
 
 void SerialPipe::txIrqBuf(void)
 {
+#ifdef PIPE_STATS
+  _txIrq ++;
+#endif
   txCopy();
   // detach tx isr if we are done
   if (!_pipeTx.readable())
@@ -70,6 +167,14 @@ void SerialPipe::txIrqBuf(void)
 
 void SerialPipe::txStart(void)
 {
+  if (_txDma) {
+    // the completion interrupt also starts blocks
+    __disable_irq();
+    if (!_txDmaLen)
+      txDmaNext();
+    __enable_irq();
+    return;
+  }
   // disable the tx isr to avoid interruption
   attach(NULL, TxIrq);
   txCopy();
@@ -78,6 +183,38 @@ void SerialPipe::txStart(void)
     attach(this, &SerialPipe::txIrqBuf, TxIrq);
 }
 
+void SerialPipe::txDma(SerialDma* dma)
+{
+  attach(NULL, TxIrq);
+  _txDma = dma;
+  _txDmaLen = 0;
+  txStart();
+}
+
+void SerialPipe::txDmaIrq(void* param)
+{
+  ((SerialPipe*)param)->txDmaBuf();
+}
+
+void SerialPipe::txDmaBuf(void)
+{
+#ifdef PIPE_STATS
+  _txIrq ++;
+#endif
+  // release the whole block at once, this wakes a blocked writer
+  _pipeTx.readCommit(_txDmaLen);
+  txDmaNext();
+}
+
+void SerialPipe::txDmaNext(void)
+{
+  Pipe<char>::Span s[2];
+  _pipeTx.readSpans(s);
+  _txDmaLen = s[0].n;
+  if (_txDmaLen && !_txDma->txStart(s[0].p, s[0].n, &SerialPipe::txDmaIrq, this))
+    _txDmaLen = 0;
+}
+
   // rx channel
 int SerialPipe::readable(void)
 {
@@ -91,20 +228,101 @@ int SerialPipe::getc(void)
   return _pipeRx.getc();
 }
 
-int SerialPipe::get(void* buffer, int length, bool blocking)
+int SerialPipe::get(void* buffer, int length, bool blocking, int timeout_ms)
 {
-  return _pipeRx.get((char*)buffer,length,blocking);
+  return _pipeRx.get((char*)buffer,length,blocking,timeout_ms);
 }
 
 void SerialPipe::rxIrqBuf(void)
 {
+  Pipe<char>::Span s[2];
+  int n = 0;
+  int d = 0;
+#ifdef PIPE_STATS
+  _rxIrq ++;
+#endif
+  _pipeRx.writeSpans(s);
+  // store directly into the free space, publish once at the end
+  char* p = s[0].p;
+  int   m = s[0].n;
   while (_SerialPipeBase::readable())
   {
     char c = _SerialPipeBase::_base_getc();
-    if (_pipeRx.writeable()) {
-      _pipeRx.putc(c);
+    if (!m && s[1].n) {
+      p = s[1].p;
+      m = s[1].n;
+      s[1].n = 0;
+    }
+    if (m) {
+      *p++ = c;
+      m --;
+      n ++;
     } else {
       /* overflow */;
+      d ++;
+    }
+  }
+  if (n)
+    _pipeRx.writeCommit(n);
+  if (d)
+    _pipeRx.drop(d);
+  rxFlowStop();
+}
+
+bool SerialPipe::rxDma(SerialDma* dma)
+{
+  Pipe<char>::Span s[2];
+  attach(NULL, RxIrq);
+  if (_rxDma)
+    _rxDma->rxStop();
+  _rxDma = NULL;
+  _rxDmaCnt = 0;
+  _rxDmaLag = 0;
+  if (dma) {
+    // the dma starts at the beginning of the buffer, so do the indexes
+    _pipeRx.reset();
+    _pipeRx.writeSpans(s);
+    if (dma->rxStart(s[0].p, s[0].n, &SerialPipe::rxDmaIrq, this)) {
+      _rxDma = dma;
+      return true;
     }
   }
+  // fall back to interrupt driven receive
+  attach(this, &SerialPipe::rxIrqBuf, RxIrq);
+  return (dma == NULL);
+}
+
+void SerialPipe::rxDmaIrq(void* param)
+{
+  ((SerialPipe*)param)->rxDmaBuf();
+}
+
+void SerialPipe::rxDmaBuf(void)
+{
+  int m = _pipeRx.capacity() - 1;
+  unsigned int c = _rxDma->rxCount() - _rxDmaCnt;
+  // a full buffer is complete, more than that was partly overwritten
+  // before it was published (late interrupts), keep the newest data that
+  // is in order from the write position on, the pipe only skips whole laps
+  int n = c ? (int)((c - 1) & m) + 1 : 0;
+  int f = _pipeRx.free();
+#ifdef PIPE_STATS
+  _rxIrq ++;
+#endif
+  if (c - n) {
+    _pipeRx.drop((int)(c - n));
+    _rxDmaCnt += c - n;
+  }
+  // the dma keeps writing if the reader is behind, this overwrites
+  // unread data, publish what fits and account the rest as dropped
+  int lag = (n > f) ? n - f : 0;
+  n -= lag;
+  if (n) {
+    _pipeRx.writeCommit(n);
+    _rxDmaCnt += n;
+  }
+  if (lag > _rxDmaLag)
+    _pipeRx.drop(lag - _rxDmaLag);
+  _rxDmaLag = lag;
+  rxFlowStop();
 }
@@ -2,6 +2,7 @@
 
 #include "mbed.h"
 #include "Pipe.h"
+#include "SerialDma.h"
 
 #define _SerialPipeBase SerialBase //!< base class used by this class
 
@@ -15,13 +16,67 @@ public:
    *  \param rx the receiving pin
    *  \param rxSize the size of the receiving buffer
    *  \param txSize the size of the transmitting buffer
+   *  \param rxBuf optional receiving buffer, allocated if NULL
+   *  \param txBuf optional transmitting buffer, allocated if NULL
    */
-  SerialPipe(PinName tx, PinName rx, int rxSize = 128, int txSize = 128);
+  SerialPipe(PinName tx, PinName rx, int rxSize = 128, int txSize = 128,
+             char* rxBuf = NULL, char* txBuf = NULL);
 
   /** Destructor
    */
   virtual ~SerialPipe(void);
 
+  /** Attach signals to let a blocked thread sleep instead of spinning
+   *  (see #PipeSignalRtos). Pass NULL to detach.
+   *  \param rx signal notified from the rx interrupt when data arrived
+   *  \param tx signal notified from the tx interrupt when space is free
+   */
+  void attachSignals(PipeSignal* rx, PipeSignal* tx);
+
+  /** Receive with DMA instead of an interrupt per character. The DMA
+   *  writes circularly into the storage of the receive pipe and the
+   *  idle line (and half/full buffer) interrupt publishes the new data.
+   *  Data the DMA overwrote before it was published is counted as dropped.
+   *  Call this before data is received, the receive pipe is reset.
+   *  \param dma the DMA backend to use, NULL to return to interrupt mode
+   *  \return true if successful
+   */
+  bool rxDma(SerialDma* dma);
+
+  /** Transmit with DMA instead of an interrupt per character. Each
+   *  contiguous span of the transmit pipe is handed to the DMA in one
+   *  block, its completion releases the space and notifies the tx signal.
+   *  Call this while nothing is transmitted.
+   *  \param dma the DMA backend to use, NULL to return to interrupt mode
+   */
+  void txDma(SerialDma* dma);
+
+  /** Throttle the sender with the RTS line when the receive pipe fills
+   *  up, instead of dropping the data that does not fit. RTS is released
+   *  (high) when the fill level reaches the high watermark and asserted
+   *  (low) again when the reader brought it down to the low watermark.
+   *  \param rts the pin used as RTS output, NC to disable
+   *  \param high the fill level that stops the sender
+   *  \param low the fill level that resumes the sender
+   */
+  void rxFlow(PinName rts, int high, int low);
+
+  //! Statistics of the serial port, see #stats
+  typedef struct {
+    PipeStats    rx;     //!< receive pipe, dropped counts the rx overflows
+    PipeStats    tx;     //!< transmit pipe
+    unsigned int rxIrq;  //!< number of receive interrupts
+    unsigned int txIrq;  //!< number of transmit interrupts
+    unsigned int rxStop; //!< number of times the sender was stopped (see #rxFlow)
+  } Stats;
+
+  /** Get the statistics of the serial port
+   *  \param st the statistics
+   *  \param reset set to true to restart the counters
+   *  \return true if successful, false if compiled without PIPE_STATS
+   */
+  bool stats(Stats* st, bool reset = false);
+
   // tx channel
   //----------------------------------------------------
 
@@ -41,9 +96,11 @@ public:
    *  \param length the size of the buffer to send
    *  \param blocking, if true this function will block
    *          until all bytes placed in the buffer.
+   *  \param timeout_ms the time to wait for space when blocking
    *  \return the number of bytes written
    */
-  int put(const void* buffer, int length, bool blocking);
+  int put(const void* buffer, int length, bool blocking,
+          int timeout_ms = PipeSignal::FOREVER);
 
   // rx channel
   //----------------------------------------------------
@@ -62,19 +119,81 @@ public:
    *  \param pointer to the buffer to read.
    *  \param length number of bytes to read
    *  \param blocking true if all bytes shall be read. false if only the available bytes.
+   *  \param timeout_ms the time to wait for data when blocking
    *  \return the number of bytes read.
    */
-  int get(void* buffer, int length, bool blocking);
+  int get(void* buffer, int length, bool blocking,
+          int timeout_ms = PipeSignal::FOREVER);
 
 protected:
+  /** Signal notified by the reader of the receive pipe whenever it
+   *  released data, used to resume the sender (see #rxFlow).
+   */
+  class RxFlowSignal : public PipeSignal
+  {
+  public:
+    //! Constructor
+    RxFlowSignal(SerialPipe* pipe) : _pipe(pipe) { }
+    //! the receive interrupt never waits
+    virtual bool wait(int timeout_ms) { return false; }
+    virtual void notify(void) { _pipe->rxFlowResume(); }
+  protected:
+    SerialPipe* _pipe; //!< the serial port to resume
+  };
+  //! stop the sender if the receive pipe reached the high watermark
+  void rxFlowStop(void);
+  //! resume the sender if the receive pipe dropped to the low watermark
+  void rxFlowResume(void);
   //! receive interrupt routine
   void rxIrqBuf(void);
+  //! receive dma interrupt routine (idle line, half/full buffer)
+  static void rxDmaIrq(void* param);
+  //! publish the data the dma has written
+  void rxDmaBuf(void);
   //! transmit interrupt woutine
   void txIrqBuf(void);
   //! start transmission helper
   void txStart(void);
+  //! transmit dma interrupt routine (block done)
+  static void txDmaIrq(void* param);
+  //! release the block sent and start the next one
+  void txDmaBuf(void);
+  //! hand the next span of the pipe to the dma
+  void txDmaNext(void);
   //! move bytes to hardware
   void txCopy(void);
   Pipe<char> _pipeRx; //!< receive pipe
   Pipe<char> _pipeTx; //!< transmit pipe
+  SerialDma* _rxDma;    //!< receive dma backend, NULL if interrupt driven
+  unsigned int _rxDmaCnt; //!< received bytes the pipe is published up to
+  int        _rxDmaLag; //!< data the dma wrote that did not fit the pipe
+  SerialDma* _txDma;    //!< transmit dma backend, NULL if interrupt driven
+  volatile int _txDmaLen; //!< size of the block the dma is sending
+  gpio_t        _rxRts;         //!< rts output used to stop the sender
+  int           _rxFlowHigh;    //!< fill level that stops the sender, 0 if disabled
+  int           _rxFlowLow;     //!< fill level that resumes the sender
+  volatile bool _rxFlowStopped; //!< the sender is stopped
+  RxFlowSignal  _rxFlowSignal;  //!< notified by the reader
+#ifdef PIPE_STATS
+  volatile unsigned int _rxIrq; //!< number of receive interrupts
+  volatile unsigned int _txIrq; //!< number of transmit interrupts
+  volatile unsigned int _rxStop; //!< number of times the sender was stopped
+#endif
+};
+
+/** Storage for statically sized serial buffers. Derive from it before the
+ *  SerialPipe based class so the storage exists when the pipes are
+ *  constructed, e.g. see #MDMSerialStatic.
+ *  \tparam RXSIZE the size of the receiving buffer (power of two)
+ *  \tparam TXSIZE the size of the transmitting buffer (power of two)
+ */
+template <int RXSIZE, int TXSIZE>
+class SerialPipeStorage
+{
+protected:
+  //! the sizes have to be a power of two
+  typedef char _checkSize[((RXSIZE > 0) && !(RXSIZE & (RXSIZE - 1)) &&
+                           (TXSIZE > 0) && !(TXSIZE & (TXSIZE - 1))) ? 1 : -1];
+  char _rxStorage[RXSIZE]; //!< receive buffer
+  char _txStorage[TXSIZE]; //!< transmit buffer
 };
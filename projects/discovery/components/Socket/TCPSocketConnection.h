@@ -12,7 +12,43 @@ class TCPSocketConnection: public Socket
 public:
   /** TCP socket connection
    */
-  TCPSocketConnection() {}
+  TCPSocketConnection() : _rx(NULL), _tx(NULL), _txSize(0), _txDelay(0) {}
+
+  /** Read the received data ahead into a buffer, so #receive is served
+   *  from memory, see MDMParser::socketPrefetch.
+   *  \param rx the buffer, NULL to read on demand
+   *  \return 0 on success, -1 on failure.
+   */
+  int set_prefetch(Pipe<char>* rx)
+  {
+    _rx = rx;
+    if ((_socket >= 0) && !_mdm->socketPrefetch(_socket, _rx))
+      return -1;
+    return 0;
+  }
+
+  /** Gather the sent data in a buffer, so many small #send become one
+   *  modem write, see MDMParser::socketCoalesce.
+   *  \param tx the buffer, NULL to send at once
+   *  \param size the number of bytes that triggers the write, 0 when full
+   *  \param delay_ms the longest time data waits in the buffer, 0 to
+   *          wait for size, #flush or #send_all only
+   *  \return 0 on success, -1 on failure.
+   */
+  int set_coalesce(Pipe<char>* tx, int size = 0, int delay_ms = 0)
+  {
+    _tx = tx;
+    _txSize = size;
+    _txDelay = delay_ms;
+    if ((_socket >= 0) && !_mdm->socketCoalesce(_socket, _tx, _txSize, _txDelay))
+      return -1;
+    return 0;
+  }
+
+  /** Write the data gathered by #send to the remote host.
+   *  \return the number of written bytes on success (>=0) or -1 on failure
+   */
+  int flush(void)                         { return _mdm->socketFlush(_socket); }
 
   /** Connects this TCP socket to the server
    *  \param host The host to connect to. It can either be an IP Address or a hostname that will be resolved with DNS.
@@ -34,6 +70,10 @@ public:
     }
 
     _mdm->socketSetBlocking(_socket, _timeout_ms);
+    if (_rx)
+      _mdm->socketPrefetch(_socket, _rx);
+    if (_tx)
+      _mdm->socketCoalesce(_socket, _tx, _txSize, _txDelay);
     if (!_mdm->socketConnect(_socket, host, port)) {
       return -1;
     }
@@ -51,12 +91,55 @@ public:
    */
   int send(char* data, int length)        { return _mdm->socketSend(_socket, data, length); }
 
-  /** Send all the data to the remote host.
+  /** Send data from several fragments to the remote host, in one write
+   *  (or the send buffer, see #set_coalesce).
+   *  \param vec The fragments to send to the host.
+   *  \param num The number of fragments.
+   *  \return the number of written bytes on success (>=0) or -1 on failure
+   */
+  int send(const MDMParser::SocketVec* vec, int num) { return _mdm->socketSendVec(_socket, vec, num); }
+
+  /** Send all the data to the remote host, together with the data
+   *  gathered before (see #set_coalesce).
    *  \param data The buffer to send to the host.
    *  \param length The length of the buffer to send.
    *  \return the number of written bytes on success (>=0) or -1 on failure
    */
-  int send_all(char* data, int length)    { return send(data,length); }
+  int send_all(char* data, int length)
+  {
+    MDMParser::SocketVec vec = { data, length };
+    return send_all(&vec, 1);
+  }
+
+  /** Send all the data from several fragments to the remote host,
+   *  together with the data gathered before (see #set_coalesce).
+   *  \param vec The fragments to send to the host.
+   *  \param num The number of fragments.
+   *  \return the number of written bytes on success (>=0) or -1 on failure
+   */
+  int send_all(const MDMParser::SocketVec* vec, int num)
+  {
+    int cnt = send(vec, num);
+    // after a partial write send the rest fragment by fragment
+    for (int i = 0, skip = cnt; (cnt >= 0) && (i < num); i ++) {
+      if (skip >= vec[i].len) {
+        skip -= vec[i].len;
+        continue;
+      }
+      while ((cnt >= 0) && (skip < vec[i].len)) {
+        int n = send((char*)vec[i].buf + skip, vec[i].len - skip);
+        if (n > 0) {
+          skip += n;
+          cnt += n;
+        } else
+          cnt = -1;
+      }
+      skip = 0;
+    }
+    if ((cnt < 0) || (_tx && (flush() < 0)))
+      return -1;
+    return cnt;
+  }
 
   /** Receive data from the remote host.
    *  \param data The buffer in which to store the data received from the host.
@@ -72,6 +155,11 @@ public:
    */
   int receive_all(char* data, int length) { return receive(data,length); }
 
+protected:
+  Pipe<char>* _rx;      //!< the buffer the data is read ahead into, NULL if none
+  Pipe<char>* _tx;      //!< the buffer the sent data is gathered in, NULL if none
+  int         _txSize;  //!< the size that triggers the write of _tx
+  int         _txDelay; //!< the longest time data waits in _tx
 };
 
 #endif
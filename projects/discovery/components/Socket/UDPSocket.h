@@ -53,13 +53,33 @@ public:
   int set_broadcasting(bool broadcast=true)       { return -1; }
 
   int sendTo(Endpoint &remote, char *packet, int length)
+  {
+    MDMParser::SocketVec vec = { packet, length };
+    return sendTo(remote, &vec, 1);
+  }
+
+  int sendTo(Endpoint &remote, const MDMParser::SocketVec* vec, int num)
+  {
+    char* str = remote.get_address();
+    int port = remote.get_port();
+    MDMParser::IP ip = _mdm->gethostbyname(str);
+    if (ip == NOIP)
+      return -1;
+    return _mdm->socketSendToVec(_socket, ip, port, vec, num);
+  }
+
+  int sendToBatch(Endpoint &remote, MDMParser::SocketDatagram* dgrams, int num)
   {
     char* str = remote.get_address();
     int port = remote.get_port();
     MDMParser::IP ip = _mdm->gethostbyname(str);
     if (ip == NOIP)
       return -1;
-    return _mdm->socketSendTo(_socket, ip, port, packet, length);
+    for (int i = 0; i < num; i ++) {
+      dgrams[i].ip = ip;
+      dgrams[i].port = port;
+    }
+    return _mdm->socketSendToBatch(_socket, dgrams, num);
   }
 
   int receiveFrom(Endpoint &remote, char *buffer, int length)
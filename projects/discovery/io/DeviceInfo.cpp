@@ -2,8 +2,10 @@
 #include <stdlib.h>
 #include <string.h>
 
-DeviceInfo::DeviceInfo(MDMSerial& mdm, MDMParser::DevStatus& devStatus) :
-    _mdm(mdm)
+DeviceInfo::DeviceInfo(MDMSerial& mdm, MDMParser::DevStatus& devStatus,
+                       int maxAge_ms /*= NET_STATUS_MAX_AGE*/) :
+    _mdm(mdm),
+    _maxAge(maxAge_ms)
 {
   *_cellId = '\0';
   memcpy(&_devStatus, &devStatus, sizeof(MDMParser::DevStatus));
@@ -53,5 +55,5 @@ DeviceInfo::SignalQuality * DeviceInfo::signalQuality()
 
 bool DeviceInfo::refreshNetStatus()
 {
-  return _mdm.checkNetStatus(&_netStatus);
+  return _mdm.netStatus(&_netStatus, _maxAge);
 }
@@ -4,10 +4,14 @@
 #include <stdint.h>
 #include "MDM.h"
 
+//! the maximum age of the polled network status (signal strength) in ms
+#define NET_STATUS_MAX_AGE 30000
+
 class DeviceInfo
 {
 public:
-  DeviceInfo(MDMSerial& mdm, MDMParser::DevStatus& devStatus);
+  DeviceInfo(MDMSerial& mdm, MDMParser::DevStatus& devStatus,
+             int maxAge_ms = NET_STATUS_MAX_AGE);
 
   typedef struct {
     int rssi;   // RSSI in dBm
@@ -27,6 +31,7 @@ private:
   MDMSerial& _mdm;
   MDMParser::DevStatus _devStatus;
   MDMParser::NetStatus _netStatus;
+  int _maxAge;
   char _cellId[9];
   SignalQuality _signalQuality;
 };
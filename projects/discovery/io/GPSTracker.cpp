@@ -4,8 +4,8 @@
 
 GPSTracker::GPSTracker(GPSI2C& gps) :
     _gps(gps),
-    _thread(GPSTracker::thread_func, this),
-    _positionSet(false)
+    _positionSet(false),
+    _thread(GPSTracker::thread_func, this, osPriorityNormal, sizeof(_stack), (unsigned char*)_stack)
 {
 }
 
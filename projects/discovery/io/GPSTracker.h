@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 #include "GPS.h"
 #include "rtos.h"
 
@@ -34,9 +35,10 @@ protected:
   static void thread_func(void const*);
 
 private:
-  GPSI2C _gps;
-  Thread _thread;
+  GPSI2C& _gps;
   Mutex _mutex;
   Position _position;
   bool _positionSet;
+  uint64_t _stack[DEFAULT_STACK_SIZE/8]; // thread stack, not on the heap, 8 byte aligned
+  Thread _thread; // last, it runs as soon as it is constructed
 };
@@ -35,15 +35,28 @@
 //#define SIM_USER ""
 //#define SIM_PASS ""
 
+/**
+* Move the modem data with DMA (USART2) instead of an interrupt per character.
+*/
+//#define MDM_DMA
+
 int main() {
   MDMParser::DevStatus devStatus;
   //int res;
   uint8_t status = 0;
 
-  MDMRtos<MDMSerial> mdm;
-  GPSI2C gps;
+  // static, so the objects and their buffers are placed in .bss
+#if defined(MDM_DMA) && defined(TARGET_STM32L0)
+  static SerialDmaSTM32L0 mdmDma; // has to outlive the modem
+#endif
+  static MDMRtos<MDMSerialStatic<256, 128> > mdm;
+  static GPSI2CStatic<256> gps;
 
   mdm.setDebug(4);
+#if defined(MDM_DMA) && defined(TARGET_STM32L0)
+  mdm.rxDma(&mdmDma);
+  mdm.txDma(&mdmDma);
+#endif
 
   if (!mdm.init(SIM_PIN, &devStatus))
     status = 1;
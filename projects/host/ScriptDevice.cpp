@@ -0,0 +1,155 @@
+#include "ScriptDevice.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+ScriptDevice::ScriptDevice(int fd)
+{
+  _fd = fd;
+  _run = false;
+  _started = false;
+  _commands = 0;
+  _baud = 0;
+  _raw = 0;
+  _received = 0;
+}
+
+ScriptDevice::~ScriptDevice(void)
+{
+  _run = false;
+  if (_started)
+    pthread_join(_tid, NULL);
+}
+
+//! replace the escapes of a response
+static std::string _unescape(const std::string& s)
+{
+  std::string r;
+  for (size_t i = 0; i < s.size(); i ++) {
+    char c = s[i];
+    if ((c == '\\') && (i + 1 < s.size())) {
+      c = s[++i];
+      if      (c == 'r') c = '\r';
+      else if (c == 'n') c = '\n';
+      else if (c == 't') c = '\t';
+    }
+    r += c;
+  }
+  return r;
+}
+
+void ScriptDevice::add(const char* line)
+{
+  std::string l(line);
+  while (!l.empty() && ((l[l.size()-1] == '\n') || (l[l.size()-1] == '\r')))
+    l.erase(l.size()-1);
+  if (l.empty() || (l[0] == '#'))
+    return;
+  Entry e;
+  size_t p = l.find('\t');
+  e.cmd = l.substr(0, p);
+  e.any = !e.cmd.empty() && (e.cmd[e.cmd.size()-1] == '*');
+  if (e.any)
+    e.cmd.erase(e.cmd.size()-1);
+  e.raw = false;
+  while (p != std::string::npos) {
+    size_t n = l.find('\t', p + 1);
+    std::string r = _unescape(l.substr(p + 1, (n == std::string::npos) ? n : n - p - 1));
+    std::string& resp = e.raw ? e.data : e.resp;
+    if (!r.empty() && (r[0] == '@')) {
+      resp += "\r\n" + r;
+      e.raw = true;
+    } else
+      resp += "\r\n" + r + "\r\n";
+    p = n;
+  }
+  _script.push_back(e);
+}
+
+bool ScriptDevice::load(const char* path)
+{
+  FILE* f = fopen(path, "r");
+  if (!f)
+    return false;
+  char line[512];
+  while (fgets(line, sizeof(line), f))
+    add(line);
+  fclose(f);
+  return true;
+}
+
+void ScriptDevice::start(void)
+{
+  _run = true;
+  _started = (pthread_create(&_tid, NULL, _thread, this) == 0);
+}
+
+void ScriptDevice::send(const char* buf, int len)
+{
+  while (len > 0) {
+    // a uart sends 10 bits per byte, pace it in small chunks
+    int n = (_baud && (len > 16)) ? 16 : len;
+    if (_baud)
+      usleep(n * 10000000LL / _baud);
+    n = ::write(_fd, buf, n);
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      break;
+    }
+    buf += n;
+    len -= n;
+  }
+}
+
+void ScriptDevice::_answer(const std::string& line)
+{
+  _commands ++;
+  for (size_t i = 0; i < _script.size(); i ++) {
+    const Entry& e = _script[i];
+    if (e.any ? (line.compare(0, e.cmd.size(), e.cmd) == 0) : (line == e.cmd)) {
+      send(e.resp.data(), e.resp.size());
+      if (e.raw) {
+        // the size of the data is the last number of the command
+        size_t p = line.find_last_of("0123456789");
+        size_t b = line.find_last_not_of("0123456789", p);
+        _raw = (p == std::string::npos) ? 0 :
+               atoi(line.substr((b == std::string::npos) ? 0 : b + 1).c_str());
+        _rawResp = e.data;
+        if (!_raw)
+          send(_rawResp.data(), _rawResp.size());
+      }
+      return;
+    }
+  }
+}
+
+void* ScriptDevice::_thread(void* param)
+{
+  ScriptDevice* that = (ScriptDevice*)param;
+  std::string line;
+  while (that->_run) {
+    struct pollfd pfd = { that->_fd, POLLIN, 0 };
+    if (poll(&pfd, 1, 10) <= 0)
+      continue;
+    char buf[256];
+    int n = ::read(that->_fd, buf, sizeof(buf));
+    if (n <= 0)
+      break;
+    for (int i = 0; i < n; i ++) {
+      if (that->_raw) {
+        that->_received ++;
+        if (!--that->_raw)
+          that->send(that->_rawResp.data(), that->_rawResp.size());
+      } else if (buf[i] == '\r') {
+        that->_answer(line);
+        line.clear();
+      } else if (buf[i] != '\n')
+        line += buf[i];
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+/** Scripted stand-in for a device on the other end of a serial port
+ *  (e.g. a modem). It reads command lines terminated by a carriage
+ *  return and answers each with the response of the first script entry
+ *  that matches.
+ *
+ *  A script line has the form: command TAB response [TAB response ...]
+ *  - a command ending with '*' matches all lines starting with it,
+ *    a command '*' alone matches any line
+ *  - each response is sent as "\r\n" response "\r\n", a response
+ *    starting with '@' is a prompt and sent without the trailing "\r\n"
+ *  - after a prompt the device takes as many bytes of raw data as the
+ *    last number of the command line, the responses that follow the
+ *    prompt are sent once the data was received
+ *  - the escapes \r \n \t and \\ can be used in responses
+ *  - empty lines and lines starting with '#' are ignored
+ */
+class ScriptDevice
+{
+public:
+  /** Constructor
+   *  \param fd the file descriptor of the device side of the port
+   */
+  ScriptDevice(int fd);
+  //! Destructor, stops the device
+  ~ScriptDevice(void);
+
+  /** Add a line to the script
+   *  \param line the script line
+   */
+  void add(const char* line);
+
+  /** Load a script file
+   *  \param path the path of the file
+   *  \return true if successful
+   */
+  bool load(const char* path);
+
+  //! Start answering in a thread
+  void start(void);
+
+  /** Send unsolicited data (e.g. a URC)
+   *  \param buf the data to send
+   *  \param len the size of the data
+   */
+  void send(const char* buf, int len);
+
+  /** Pace the sent data like a uart, instead of sending it at once
+   *  \param baudrate the bits per second, 0 to send at once
+   */
+  void baud(int baudrate) { _baud = baudrate; }
+
+  //! Get the number of commands received
+  int commands(void) { return _commands; }
+
+  //! Get the number of raw data bytes received after prompts
+  int received(void) { return _received; }
+
+protected:
+  //! a script entry
+  typedef struct {
+    std::string cmd;   //!< the command to match (without '*')
+    bool        any;   //!< match all commands starting with cmd
+    std::string resp;  //!< the framed response
+    std::string data;  //!< the framed response after the raw data
+    bool        raw;   //!< raw data follows the prompt
+  } Entry;
+  //! answer a received command line
+  void _answer(const std::string& line);
+  //! the device thread
+  static void* _thread(void* param);
+  int                _fd;       //!< the device side of the port
+  std::vector<Entry> _script;   //!< the script
+  volatile bool      _run;      //!< the thread runs
+  bool               _started;  //!< the thread was started
+  pthread_t          _tid;      //!< the thread
+  volatile int       _commands; //!< number of commands received
+  int                _baud;     //!< the pace of the sent data, 0 if none
+  int                _raw;      //!< raw data bytes still expected
+  std::string        _rawResp;  //!< the response once the raw data is in
+  volatile int       _received; //!< number of raw data bytes received
+};
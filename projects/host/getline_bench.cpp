@@ -0,0 +1,340 @@
+/**
+ ******************************************************************************
+ * @file    getline_bench.cpp
+ * @brief   Benchmark of the modem response lexer MDMParser::_getLine.
+ ******************************************************************************
+ * Feeds a modem capture in small chunks into a pipe and calls _getLine after
+ * each chunk like waitFinalResp does. The lexer is compared against the
+ * previous implementation that tried every pattern at every offset, both
+ * have to split the capture into the same sequence of responses.
+ *
+ * usage: getline_bench [-n loops] [-c chunk] [-v] [capture ...]
+ *
+ * A capture is the raw data received from the modem, if none is given a
+ * built-in capture of a typical session is used.
+ ******************************************************************************
+ */
+
+#include "mbed.h"
+#include "MDM.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+//! access to the protected helpers of the parser
+struct Lexer : public MDMParser
+{
+  using MDMParser::LexState;
+  using MDMParser::_lexReset;
+
+  //! the lexer with its state kept between the calls
+  static int getLine(Pipe<char>* pipe, char* buf, int len)
+  {
+    return _getLine(pipe, buf, len, &lex);
+  }
+  static LexState lex; //!< parsing state of the pipe used in #run
+
+  //! the previous _parseMatch
+  static int legacyParseMatch(Pipe<char>* pipe, int len, const char* sta, const char* end)
+  {
+    int o = 0;
+    if (sta) {
+      while (*sta) {
+        if (++o > len)      return WAIT;
+        char ch = pipe->next();
+        if (*sta++ != ch)   return NOT_FOUND;
+      }
+    }
+    if (!end)               return o; // no termination
+    // at least any char
+    if (++o > len)          return WAIT;
+    pipe->next();
+    // check the end
+    int x = 0;
+    while (end[x]) {
+      if (++o > len)        return WAIT;
+      char ch = pipe->next();
+      x = (end[x] == ch) ? x + 1 :
+          (end[0] == ch) ? 1 :
+                          0;
+    }
+    return o;
+  }
+
+  //! the previous _parseFormated
+  static int legacyParseFormated(Pipe<char>* pipe, int len, const char* fmt)
+  {
+    int o = 0;
+    int num = 0;
+    if (fmt) {
+      while (*fmt) {
+        if (++o > len)            return WAIT;
+        char ch = pipe->next();
+        if (*fmt == '%') {
+          fmt++;
+          if (*fmt == 'd') { // numeric
+            fmt ++;
+            num = 0;
+            while (ch >= '0' && ch <= '9') {
+              num = num * 10 + (ch - '0');
+              if (++o > len)      return WAIT;
+              ch = pipe->next();
+            }
+          }
+          else if (*fmt == 'c') { // char buffer (takes last numeric as length)
+            fmt ++;
+            while (num --) {
+              if (++o > len)      return WAIT;
+              ch = pipe->next();
+            }
+          }
+          else if (*fmt == 's') {
+            fmt ++;
+            if (ch != '\"')       return NOT_FOUND;
+            do {
+              if (++o > len)      return WAIT;
+              ch = pipe->next();
+            } while (ch != '\"');
+            if (++o > len)        return WAIT;
+            ch = pipe->next();
+          }
+        }
+        if (*fmt++ != ch)         return NOT_FOUND;
+      }
+    }
+    return o;
+  }
+
+  //! the previous _getLine, tries all patterns at every offset
+  static int legacyGetLine(Pipe<char>* pipe, char* buf, int len)
+  {
+    int unkn = 0;
+    int sz = pipe->size();
+    int fr = pipe->free();
+    if (len > sz)
+      len = sz;
+    while (len > 0)
+    {
+      static struct {
+          const char* fmt;                              int type;
+      } lutF[] = {
+        { "\r\n+USORD: %d,%d,\"%c\"",                   TYPE_PLUS       },
+        { "\r\n+USORF: %d,\"" IPSTR "\",%d,%d,\"%c\"",  TYPE_PLUS       },
+        { "\r\n+URDFILE: %s,%d,\"%c\"",                 TYPE_PLUS       },
+      };
+      static struct {
+          const char* sta;          const char* end;    int type;
+      } lut[] = {
+        { "\r\nOK\r\n",             NULL,               TYPE_OK         },
+        { "\r\nERROR\r\n",          NULL,               TYPE_ERROR      },
+        { "\r\n+CME ERROR:",        "\r\n",             TYPE_ERROR      },
+        { "\r\n+CMS ERROR:",        "\r\n",             TYPE_ERROR      },
+        { "\r\nRING\r\n",           NULL,               TYPE_RING       },
+        { "\r\nCONNECT\r\n",        NULL,               TYPE_CONNECT    },
+        { "\r\nNO CARRIER\r\n",     NULL,               TYPE_NOCARRIER  },
+        { "\r\nNO DIALTONE\r\n",    NULL,               TYPE_NODIALTONE },
+        { "\r\nBUSY\r\n",           NULL,               TYPE_BUSY       },
+        { "\r\nNO ANSWER\r\n",      NULL,               TYPE_NOANSWER   },
+        { "\r\n+",                  "\r\n",             TYPE_PLUS       },
+        { "\r\n@",                  NULL,               TYPE_PROMPT     }, // Sockets
+        { "\r\n>",                  NULL,               TYPE_PROMPT     }, // SMS
+        { "\n>",                    NULL,               TYPE_PROMPT     }, // File
+      };
+      for (unsigned int i = 0; i < sizeof(lutF)/sizeof(*lutF); i ++) {
+        pipe->set(unkn);
+        int ln = legacyParseFormated(pipe, len, lutF[i].fmt);
+        if (ln == WAIT && fr)
+          return WAIT;
+        if ((ln != NOT_FOUND) && (unkn > 0))
+          return TYPE_UNKNOWN | pipe->get(buf, unkn);
+        if (ln > 0)
+          return lutF[i].type  | pipe->get(buf, ln);
+      }
+      for (unsigned int i = 0; i < sizeof(lut)/sizeof(*lut); i ++) {
+        pipe->set(unkn);
+        int ln = legacyParseMatch(pipe, len, lut[i].sta, lut[i].end);
+        if (ln == WAIT && fr)
+          return WAIT;
+        if ((ln != NOT_FOUND) && (unkn > 0))
+          return TYPE_UNKNOWN | pipe->get(buf, unkn);
+        if (ln > 0)
+          return lut[i].type | pipe->get(buf, ln);
+      }
+      // UNKNOWN
+      unkn ++;
+      len--;
+    }
+    return WAIT;
+  }
+};
+Lexer::LexState Lexer::lex;
+
+typedef int (*GetLine)(Pipe<char>* pipe, char* buf, int len);
+
+//! the built-in capture, responses of a typical session with urcs and socket data
+static std::string builtinCapture(void)
+{
+  // sizeof keeps the payloads containing '\0'
+  #define RESP(s) { s, sizeof(s) - 1 }
+  static const struct { const char* p; size_t n; } resp[] = {
+    RESP("\r\nOK\r\n"),
+    RESP("AT E0\r\r\nOK\r\n"),
+    RESP("\r\nSARA-U260-00S-00\r\n\r\nOK\r\n"),
+    RESP("\r\n+CPIN: READY\r\n\r\nOK\r\n"),
+    RESP("\r\nu-blox\r\n\r\nOK\r\n"),
+    RESP("\r\n+CCID: 8944110068256270054\r\n\r\nOK\r\n"),
+    RESP("\r\n357520070000000\r\n\r\nOK\r\n"),
+    RESP("\r\n+CME ERROR: SIM busy\r\n"),
+    RESP("\r\n+CREG: 2,1,\"0F2A\",\"01B2C3D4\",2\r\n\r\nOK\r\n"),
+    RESP("\r\n+CGREG: 2,1,\"0F2A\",\"01B2C3D4\",2,\"01\"\r\n\r\nOK\r\n"),
+    RESP("\r\n+COPS: 0,0,\"vodafone UK\",2\r\n\r\nOK\r\n"),
+    RESP("\r\n+CSQ: 19,2\r\n\r\nOK\r\n"),
+    RESP("\r\n+CREG: 1,\"0F2A\",\"01B2C3D5\",2\r\n"),
+    RESP("\r\n+UPSND: 0,0,\"10.1.2.3\"\r\n\r\nOK\r\n"),
+    RESP("\r\n+USOCR: 0\r\n\r\nOK\r\n"),
+    RESP("\r\n@"),
+    RESP("\r\n+USOWR: 0,32\r\n\r\nOK\r\n"),
+    RESP("\r\n+UUSORD: 0,64\r\n"),
+    RESP("\r\n+USORD: 0,64,\"HTTP/1.1 200 OK\r\nContent-Length: 12\r\n\r\nhello world\r\nOK\r\n\r\n!\"\r\n\r\nOK\r\n"),
+    RESP("\r\n+UUSORF: 1,24\r\n"),
+    RESP("\r\n+USORF: 1,\"192.168.1.10\",123,24,\"\x1b\r\n\x00\x01\r\nERROR\r\n\xff\xfe OK\r\n  \"\r\n\r\nOK\r\n"),
+    RESP("\r\n+URDFILE: \"cfg.txt\",9,\"a=1\r\nb=2\r\n\"\r\n\r\nOK\r\n"),
+    RESP("\r\nRING\r\n"),
+    RESP("\r\nNO CARRIER\r\n"),
+    RESP("\r\nBUSY\r\n"),
+    RESP("\r\n>"),
+    RESP("\n>"),
+    RESP("\r\nERROR\r\n"),
+    RESP("\r\n+CMS ERROR: 500\r\n"),
+    RESP("\r\n+UUSOCL: 0\r\n"),
+  };
+  std::string s;
+  for (unsigned int i = 0; i < sizeof(resp)/sizeof(*resp); i ++)
+    s.append(resp[i].p, resp[i].n);
+  // a large socket read, with a line break every 64 bytes
+  std::string d;
+  for (int i = 0; d.size() < 900; i ++)
+    d += ((i % 64) == 62) ? '\r' : ((i % 64) == 63) ? '\n' : (char)('a' + (i % 26));
+  s += "\r\n+USORD: 0,900,\"" + d + "\"\r\n\r\nOK\r\n";
+  return s;
+}
+
+//! feed the capture in chunks and collect the responses
+static std::vector<int> run(GetLine getLine, const std::string& cap, int chunk)
+{
+  std::vector<int> out;
+  Pipe<char, 1024> pipe;
+  Lexer::_lexReset(&Lexer::lex);
+  char buf[1024];
+  size_t i = 0;
+  while ((i < cap.size()) || pipe.readable()) {
+    int n = (int)(cap.size() - i);
+    if (n > chunk)
+      n = chunk;
+    if (n > pipe.free())
+      n = pipe.free();
+    if (n > 0) {
+      pipe.put(cap.data() + i, n, false);
+      i += n;
+    }
+    int ret;
+    while ((ret = getLine(&pipe, buf, sizeof(buf))) > 0)
+      out.push_back(ret);
+    if ((i == cap.size()) && pipe.readable()) {
+      // flush the incomplete tail
+      out.push_back(MDMParser::TYPE_UNKNOWN | pipe.get(buf, pipe.size()));
+    } else if ((n == 0) && !pipe.free()) {
+      out.push_back(-2); // stalled on a full pipe
+      break;
+    }
+  }
+  return out;
+}
+
+//! run a lexer repeatedly and return the time in ns per byte
+static double bench(GetLine getLine, const std::string& cap, int chunk, int loops)
+{
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (int i = 0; i < loops; i ++)
+    run(getLine, cap, chunk);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+  return ns / ((double)cap.size() * loops);
+}
+
+static bool readFile(const char* path, std::string& s)
+{
+  FILE* f = fopen(path, "rb");
+  if (!f)
+    return false;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    s.append(buf, n);
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  int loops = 2000;
+  int chunk = 0;
+  bool verbose = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:c:v")) != -1) {
+    switch (opt) {
+      case 'n': loops   = atoi(optarg); break;
+      case 'c': chunk   = atoi(optarg); break;
+      case 'v': verbose = true;         break;
+      default:
+        fprintf(stderr, "usage: %s [-n loops] [-c chunk] [-v] [capture ...]\n", argv[0]);
+        return 2;
+    }
+  }
+  std::vector<std::pair<std::string, std::string> > caps;
+  if (optind == argc)
+    caps.push_back(std::make_pair(std::string("built-in"), builtinCapture()));
+  for (int i = optind; i < argc; i ++) {
+    std::string s;
+    if (!readFile(argv[i], s)) {
+      perror(argv[i]);
+      return 1;
+    }
+    caps.push_back(std::make_pair(std::string(argv[i]), s));
+  }
+  // chunk sizes similar to what a serial irq or dma delivers per wakeup
+  static const int chunks[] = { 1, 8, 64, 512 };
+  int failed = 0;
+  for (size_t c = 0; c < caps.size(); c ++) {
+    const std::string& cap = caps[c].second;
+    printf("%s: %d bytes\n", caps[c].first.c_str(), (int)cap.size());
+    for (unsigned int k = 0; k < sizeof(chunks)/sizeof(*chunks); k ++) {
+      int ch = chunk ? chunk : chunks[k];
+      if (chunk && k)
+        break;
+      std::vector<int> a = run(Lexer::legacyGetLine, cap, ch);
+      std::vector<int> b = run(Lexer::getLine, cap, ch);
+      bool same = (a == b);
+      if (!same)
+        failed ++;
+      if (verbose || !same) {
+        for (size_t i = 0; i < a.size() || i < b.size(); i ++) {
+          int x = (i < a.size()) ? a[i] : 0;
+          int y = (i < b.size()) ? b[i] : 0;
+          printf("  %c %06X %06X\n", (x == y) ? ' ' : '!', x, y);
+        }
+      }
+      int n = loops / ch + 1;
+      double tl = bench(Lexer::legacyGetLine, cap, ch, n);
+      double tn = bench(Lexer::getLine, cap, ch, n);
+      printf("  chunk %3d: %d responses %s, legacy %.1f ns/byte, lexer %.1f ns/byte, %.1fx\n",
+             ch, (int)b.size(), same ? "identical" : "DIFFERENT", tl, tn, tl / tn);
+    }
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,620 @@
+/**
+ ******************************************************************************
+ * @file    main.cpp
+ * @brief   Host (Linux) build of the modem and gps stack.
+ ******************************************************************************
+ * Runs MDMParser, GPSParser and GPSTracker unmodified on a PC. The modem is
+ * either a real device or pty (-m) or a scripted stand-in on a socketpair,
+ * the gps is a device or a NMEA/UBX log replayed over the emulated I2C (-g).
+ *
+ * usage: host [-m device] [-s script] [-g device] [-n loops] [-d level]
+ ******************************************************************************
+ */
+
+#include "mbed.h"
+#include "rtos.h"
+#include "MDM.h"
+#include "GPS.h"
+#include "GPSTracker.h"
+#include "ScriptDevice.h"
+#include "us_ticker_api.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+
+//! the default modem stand-in, a SARA-U260 that is registered and attached
+static const char* const modemScript[] = {
+  "AT\tOK",
+  "AT E0\tOK",
+  "AT+CMEE=2\tOK",
+  "AT+IPR=115200\tOK",
+  "ATI\tSARA-U260-00S-00\tOK",
+  "AT+UGPIOC=16,2\tOK",
+  "AT+CPIN?\t+CPIN: READY\tOK",
+  "AT+CGMI\tu-blox\tOK",
+  "AT+CGMM\tSARA-U260\tOK",
+  "AT+CGMR\t23.20\tOK",
+  "AT+CCID\t+CCID: 8944110068256270054\tOK",
+  "AT+CGSN\t357520070000000\tOK",
+  "AT+CGREG=2\tOK",
+  "AT+CREG=2\tOK",
+  "AT+CMGF=1\tOK",
+  "AT+CNMI=2,1\tOK",
+  "AT+CIMI\t234100000000000\tOK",
+  "AT&W\tOK",
+  "AT+CREG?;+CPIN?;+CCID\t+CREG: 2,1,\"0F2A\",\"01B2C3D4\",2\t+CPIN: READY\t+CCID: 8944110068256270054\tOK",
+  "AT+CREG?;+CGREG?;+COPS?;+CSQ\t+CREG: 2,1,\"0F2A\",\"01B2C3D4\",2\t+CGREG: 2,1,\"0F2A\",\"01B2C3D4\",2,\"01\"\t"
+      "+COPS: 0,0,\"vodafone UK\",2\t+CSQ: 19,2\tOK",
+  "AT+CREG?\t+CREG: 2,1,\"0F2A\",\"01B2C3D4\",2\tOK",
+  "AT+CGREG?\t+CGREG: 2,1,\"0F2A\",\"01B2C3D4\",2,\"01\"\tOK",
+  "AT+COPS?\t+COPS: 0,0,\"vodafone UK\",2\tOK",
+  "AT+CNUM\t+CNUM: \"My Number\",\"+447700900000\",145\tOK",
+  "AT+CSQ\t+CSQ: 19,2\tOK",
+  "AT+CGATT=1\tOK",
+  "AT+UPSND=0,8\t+UPSND: 0,8,0\tOK",
+  "AT+UPSD=*\tOK",
+  "AT+UPSDA=0,3\tOK",
+  "AT+UPSND=0,0\t+UPSND: 0,0,\"10.1.2.3\"\tOK",
+  "AT+UDNSRN=0,\"example.com\"\t+UDNSRN: \"93.184.216.34\"\tOK",
+  "AT+USOCR=6\t+USOCR: 0\tOK",
+  "AT+USOCR=17\t+USOCR: 1\tOK",
+  "AT+USOCO=0,*\tOK",
+  "AT+USOWR=0,16\tERROR",
+  "AT+USOWR=*\t@\t+USOWR: 0\tOK",
+  "AT+USOST=*\t@\t+USOST: 1\tOK",
+  "AT+USODL=0\tCONNECT",
+  "ping\tpong",
+  "+++AT\tDISCONNECT\tOK",
+  "AT+USOCL=0\tOK",
+  "AT+CPWROFF\tOK",
+  "*\tERROR",
+};
+
+//! the data of the scripted socket reads
+static char payload[600];
+
+//! count the received urcs
+static void urcCount(const char* buf, int len, volatile int* count)
+{
+  (*count) ++;
+}
+
+//! count the completed commands
+static void cmdDone(int handle, int result, int latency_ms, void* param)
+{
+  (*(volatile int*)param) ++;
+}
+
+//! send a urc for the udp socket a bit later
+static void urcLater(void const* param)
+{
+  static const char urc[] = "\r\n+UUSORF: 1,20\r\n";
+  Thread::wait(20);
+  ((ScriptDevice*)param)->send(urc, sizeof(urc) - 1);
+}
+
+//! let the us ticker run a whole lap and some ms more, in steps that the
+//! ticker interrupts see, like a device that was idle for that long
+static void tickerLap(int ms)
+{
+  for (int i = 0; i < 4; i ++) {
+    hostTicker(us_ticker_read() + 0x40000000);
+    Thread::wait(5);
+  }
+  hostTicker(us_ticker_read() + ms * 1000);
+}
+
+//! the commands queued by submitLater that completed
+static volatile int doneLater = 0;
+
+//! queue commands for the urc thread while another thread reads a socket
+static void submitLater(void const* param)
+{
+  Thread::wait(50);
+  for (int i = 0; i < 3; i ++)
+    ((MDMParser*)param)->cmdSubmit(NULL, cmdDone, (void*)&doneLater, 1000, "AT+CSQ\r\n");
+}
+
+//! close the scripted tcp socket after a while
+static void closeLater(void const* param)
+{
+  static const char urc[] = "\r\n+UUSOCL: 0\r\n";
+  Thread::wait(200);
+  ((ScriptDevice*)param)->send(urc, sizeof(urc) - 1);
+}
+
+//! the cpu time used by the calling thread in ms
+static int cpuTime(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (int)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+//! print the statistics of a serial port
+static void printStats(const char* name, SerialPipe::Stats* st)
+{
+  printf("%s: rx %u bytes peak %d dropped %u irqs %u, tx %u bytes peak %d irqs %u\n", name,
+         st->rx.in, st->rx.peak, st->rx.dropped, st->rxIrq,
+         st->tx.in, st->tx.peak, st->txIrq);
+}
+
+int main(int argc, char* argv[])
+{
+  const char* modemPath = NULL;
+  const char* scriptPath = NULL;
+  const char* gpsPath = NULL;
+  int loops = 1;
+  int level = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "m:s:g:n:d:")) != -1) {
+    switch (opt) {
+      case 'm': modemPath  = optarg;       break;
+      case 's': scriptPath = optarg;       break;
+      case 'g': gpsPath    = optarg;       break;
+      case 'n': loops      = atoi(optarg); break;
+      case 'd': level      = atoi(optarg); break;
+      default:
+        fprintf(stderr, "usage: %s [-m device] [-s script] [-g device] [-n loops] [-d level]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  // the modem, a device or the scripted stand-in
+  ScriptDevice* device = NULL;
+  int fd;
+  if (modemPath) {
+    fd = hostOpen(modemPath);
+    if (fd < 0) {
+      perror(modemPath);
+      return 1;
+    }
+  } else {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+      perror("socketpair");
+      return 1;
+    }
+    fd = sv[0];
+    device = new ScriptDevice(sv[1]);
+    if (scriptPath) {
+      if (!device->load(scriptPath)) {
+        perror(scriptPath);
+        return 1;
+      }
+    } else {
+      // the socket data, larger than the rx pipe
+      static char line[sizeof(payload) + 64];
+      for (unsigned int i = 0; i < sizeof(payload); i ++)
+        payload[i] = 'a' + (i % 26);
+      snprintf(line, sizeof(line), "AT+USORD=0,%d\t+USORD: 0,%d,\"%.*s\"\tOK",
+               (int)sizeof(payload), (int)sizeof(payload), (int)sizeof(payload), payload);
+      device->add(line);
+      for (unsigned int i = 0; i < sizeof(modemScript)/sizeof(*modemScript); i ++)
+        device->add(modemScript[i]);
+    }
+    device->baud(115200);
+    device->start();
+  }
+  hostSerial(PA_2, fd);
+
+  int failed = 0;
+  MDMParser::DevStatus devStatus;
+  MDMParser::NetStatus netStatus;
+  static MDMRtosUrc<MDMSerialStatic<256, 128> > mdm;
+  mdm.setDebug(level);
+  static volatile int urcs = 0;
+  mdm.urcAttach("+CREG", urcCount, &urcs);
+  Timer total;
+  total.start();
+  for (int i = 0; i < loops; i ++) {
+    Timer timer;
+    timer.start();
+    bool ok = mdm.init(NULL, &devStatus) &&
+              mdm.registerNet(&netStatus) &&
+              (mdm.join() != NOIP);
+    if (!ok)
+      failed ++;
+    if ((loops == 1) || !ok)
+      printf("loop %d: %s in %d ms\n", i, ok ? "ok" : "failed", timer.read_ms());
+  }
+  total.stop();
+  printf("modem: %d loops, %d failed, %d ms, %d us per loop\n", loops, failed,
+         total.read_ms(), (int)(total.read_us() / (loops ? loops : 1)));
+  if (device) {
+    printf("modem: %d commands\n", device->commands());
+    // an unsolicited registration change, picked up by the urc thread
+    static const char urc[] = "\r\n+CREG: 1,\"0F2A\",\"01B2C3D5\",2\r\n";
+    int n = urcs;
+    Timer timer;
+    timer.start();
+    device->send(urc, sizeof(urc) - 1);
+    while ((urcs == n) && (timer.read_ms() < 1000))
+      Thread::wait(1);
+    if (urcs != n)
+      printf("modem: urc handled after %d us\n", timer.read_us());
+    else {
+      printf("modem: urc not handled\n");
+      failed ++;
+    }
+    // the cached status has the new cell without asking the modem
+    n = device->commands();
+    mdm.netStatus(&netStatus, 10000);
+    printf("modem: cached cell %08X, %d commands\n", netStatus.ci, device->commands() - n);
+    if ((netStatus.ci != 0x01B2C3D5) || (device->commands() != n))
+      failed ++;
+    // the status stays cached across the wrap of the us ticker and
+    // expires after it
+    hostTicker(0xFFFFFFFF - 1000);
+    mdm.checkNetStatus();
+    Thread::wait(5);
+    n = device->commands();
+    mdm.netStatus(&netStatus, 10000);
+    int m = device->commands() - n;
+    hostTicker(us_ticker_read() + 10001000);
+    mdm.netStatus(&netStatus, 10000);
+    printf("modem: status across the ticker wrap %d commands, expired %d commands\n",
+           m, device->commands() - n - m);
+    if ((m != 0) || (device->commands() - n - m == 0))
+      failed ++;
+    // a status left alone for a whole lap of the us ticker is old, not new
+    mdm.checkNetStatus();
+    tickerLap(5000);
+    n = device->commands();
+    mdm.netStatus(&netStatus, 10000);
+    printf("modem: status after a ticker lap %d commands\n", device->commands() - n);
+    if (device->commands() == n)
+      failed ++;
+    // a warm start takes over the configured modem, a different sim does not
+    MDMParser::DevStatus cached = devStatus;
+    n = device->commands();
+    Timer warm;
+    warm.start();
+    bool ok = mdm.initWarm(&cached) && (device->commands() - n == 1);
+    printf("modem: warm start in %d us, %d commands\n", warm.read_us(), device->commands() - n);
+    if (!ok || (mdm.join() == NOIP))
+      failed ++;
+    strcpy(cached.ccid, "8944110068256270099");
+    n = device->commands();
+    if (!mdm.initWarm(&cached, NULL, &devStatus) || (device->commands() - n < 10) ||
+        strcmp(devStatus.ccid, "8944110068256270054"))
+      failed ++;
+    // repeated lookups are served from the cache, failures too
+    static const char* const hosts[] = { "example.com", "nowhere.invalid", "example.com",
+                                         "nowhere.invalid", "example.com" };
+    MDMParser::DnsStats ds;
+    mdm.dnsStats(NULL, true);
+    n = device->commands();
+    ok = true;
+    for (int i = 0; i < 5; i ++)
+      ok = ok && ((mdm.gethostbyname(hosts[i]) == NOIP) == (i & 1));
+    mdm.dnsFlush("example.com");
+    ok = ok && (mdm.gethostbyname("example.com") != NOIP);
+    mdm.dnsStats(&ds);
+    printf("modem: dns %u hits %u misses, %d commands\n", ds.hits, ds.misses, device->commands() - n);
+    if (!ok || (ds.hits != 3) || (ds.misses != 3) || (device->commands() - n != 3))
+      failed ++;
+    // the names stay across the wrap of the us ticker, the failure expires earlier
+    mdm.dnsFlush();
+    hostTicker(0xFFFFFFFF - 1000);
+    mdm.gethostbyname("example.com");
+    mdm.gethostbyname("nowhere.invalid");
+    Thread::wait(5);
+    mdm.dnsStats(NULL, true);
+    ok = (mdm.gethostbyname("example.com") != NOIP) && (mdm.gethostbyname("nowhere.invalid") == NOIP);
+    hostTicker(us_ticker_read() + (DNS_NEG_TTL_MS + 1000) * 1000);
+    ok = ok && (mdm.gethostbyname("example.com") != NOIP) && (mdm.gethostbyname("nowhere.invalid") == NOIP);
+    mdm.dnsStats(&ds);
+    printf("modem: dns across the ticker wrap %u hits %u misses\n", ds.hits, ds.misses);
+    if (!ok || (ds.hits != 3) || (ds.misses != 1))
+      failed ++;
+    // a name left alone for a whole lap of the us ticker has expired
+    mdm.dnsFlush();
+    mdm.dnsStats(NULL, true);
+    mdm.gethostbyname("example.com");
+    tickerLap(1000);
+    mdm.gethostbyname("example.com");
+    mdm.dnsStats(&ds);
+    printf("modem: dns after a ticker lap %u hits %u misses\n", ds.hits, ds.misses);
+    if ((ds.hits != 0) || (ds.misses != 2))
+      failed ++;
+  }
+  // queued commands, run by the urc thread while this one continues, the
+  // latencies are timed across the wrap of the us ticker
+  hostTicker(0xFFFFFFFF - 5000);
+  static volatile int done = 0;
+  static const char* const cmds[] = { "AT+CSQ\r\n", "AT+CREG?\r\n", "AT+CGREG?\r\n",
+                                      "AT+COPS?\r\n", "AT+CSQ\r\n", "AT+CGATT=1\r\n" };
+  const int num = sizeof(cmds)/sizeof(*cmds);
+  int queued = 0;
+  Timer timer;
+  timer.start();
+  while ((done < num) && (timer.read_ms() < 5000)) {
+    if ((queued < num) && (mdm.cmdSubmit(NULL, cmdDone, (void*)&done, 1000, cmds[queued]) != SOCKET_ERROR))
+      queued ++;
+    else
+      Thread::wait(1);
+  }
+  MDMParser::CmdStats cs;
+  mdm.cmdStats(&cs);
+  printf("modem: %d of %d queued commands in %d ms, peak depth %d, latency avg %u max %u ms, %u failed\n",
+         done, num, timer.read_ms(), cs.peak, cs.done ? cs.latencySum / cs.done : 0,
+         cs.latencyMax, cs.failed);
+  if ((done != num) || cs.failed || (cs.latencyMax > 1000))
+    failed ++;
+  if (device) {
+    // a direct link, the stand-in answers the raw data line by line
+    int socket = mdm.socketSocket(MDMParser::IPPROTO_TCP);
+    char buf[16];
+    int n = 0;
+    bool ok = (socket != SOCKET_ERROR) &&
+              mdm.socketConnect(socket, "10.0.0.1", 7) &&
+              mdm.socketSetBlocking(socket, 1000) &&
+              mdm.socketDirectLink(socket) &&
+              (mdm.socketSend(socket, "ping\r", 5) == 5);
+    while (ok && (n < 8)) {
+      int r = mdm.socketRecv(socket, buf + n, sizeof(buf) - 1 - n);
+      ok = (r > 0);
+      if (ok) n += r;
+    }
+    buf[n] = '\0';
+    ok = ok && !strcmp(buf, "\r\npong\r\n") &&
+         mdm.socketDirectLeave(socket) && mdm.socketFree(socket);
+    printf("modem: direct link %s\n", ok ? "ok" : "failed");
+    if (!ok)
+      failed ++;
+    // a socket read larger than the rx pipe, the payload is streamed into the buffer
+    static char data[sizeof(payload)];
+    static const char urc[] = "\r\n+UUSORD: 0,600\r\n";
+    socket = mdm.socketSocket(MDMParser::IPPROTO_TCP);
+    ok = (socket != SOCKET_ERROR) &&
+         mdm.socketConnect(socket, "10.0.0.1", 7) &&
+         mdm.socketSetBlocking(socket, 1000);
+    if (ok) {
+      device->send(urc, sizeof(urc) - 1);
+      n = device->commands();
+      Timer timer;
+      timer.start();
+      ok = (mdm.socketRecv(socket, data, sizeof(data)) == sizeof(data)) &&
+           !memcmp(data, payload, sizeof(data));
+      printf("modem: read %d bytes with %d commands in %d us\n", (int)sizeof(data),
+             device->commands() - n, timer.read_us());
+    }
+    ok = mdm.socketFree(socket) && ok;
+    if (!ok) {
+      printf("modem: read failed\n");
+      failed ++;
+    }
+    // the same read ahead by the urc thread, as soon as the urc arrives
+    static Pipe<char, 1024> rx;
+    socket = mdm.socketSocket(MDMParser::IPPROTO_TCP);
+    ok = (socket != SOCKET_ERROR) &&
+         mdm.socketConnect(socket, "10.0.0.1", 7) &&
+         mdm.socketSetBlocking(socket, 1000) &&
+         mdm.socketPrefetch(socket, &rx);
+    if (ok) {
+      memset(data, 0, sizeof(data));
+      device->send(urc, sizeof(urc) - 1);
+      Timer timer;
+      timer.start();
+      while ((rx.size() < (int)sizeof(data)) && (timer.read_ms() < 1000))
+        Thread::wait(1);
+      int t = timer.read_us();
+      n = device->commands();
+      timer.reset();
+      ok = (mdm.socketRecv(socket, data, sizeof(data)) == sizeof(data)) &&
+           !memcmp(data, payload, sizeof(data)) && (device->commands() == n);
+      printf("modem: prefetched %d bytes in %d us, read in %d us\n", (int)sizeof(data),
+             t, timer.read_us());
+    }
+    ok = mdm.socketFree(socket) && ok;
+    if (!ok) {
+      printf("modem: prefetch failed\n");
+      failed ++;
+    }
+    // wait on two sockets, the urc arrives while waiting
+    int tcp = mdm.socketSocket(MDMParser::IPPROTO_TCP);
+    int udp = mdm.socketSocket(MDMParser::IPPROTO_UDP);
+    ok = (tcp != SOCKET_ERROR) && (udp != SOCKET_ERROR) &&
+         mdm.socketConnect(tcp, "10.0.0.1", 7);
+    if (ok) {
+      MDMParser::SocketPoll fds[] = { { tcp, MDMParser::SOCKET_READABLE, 0 },
+                                      { udp, MDMParser::SOCKET_READABLE, 0 } };
+      Timer timer;
+      timer.start();
+      Thread later(urcLater, device);
+      int r = mdm.socketPoll(fds, 2, 1000);
+      ok = (r == 1) && !fds[0].revents && (fds[1].revents == MDMParser::SOCKET_READABLE);
+      printf("modem: poll %d ready after %d us\n", r, timer.read_us());
+    }
+    ok = mdm.socketFree(tcp) && mdm.socketFree(udp) && ok;
+    if (!ok) {
+      printf("modem: poll failed\n");
+      failed ++;
+    }
+    // a blocking read without data sleeps until the socket is closed, the
+    // commands the urc thread runs meanwhile are answered in time
+    socket = mdm.socketSocket(MDMParser::IPPROTO_TCP);
+    ok = (socket != SOCKET_ERROR) &&
+         mdm.socketConnect(socket, "10.0.0.1", 7) &&
+         mdm.socketSetBlocking(socket, MDMParser::TIMEOUT_BLOCKING);
+    if (ok) {
+      Timer timer;
+      timer.start();
+      int cpu = cpuTime();
+      Thread later(closeLater, device);
+      Thread submit(submitLater, (MDMParser*)&mdm);
+      ok = (mdm.socketRecv(socket, data, sizeof(data)) == 0);
+      cpu = cpuTime() - cpu;
+      printf("modem: blocking read returned after %d ms, %d ms cpu\n", timer.read_ms(), cpu);
+      ok = ok && (cpu < 50);
+      while ((doneLater < 3) && (timer.read_ms() < 2000))
+        Thread::wait(1);
+      printf("modem: %d commands next to the read done after %d ms\n", doneLater, timer.read_ms());
+      ok = ok && (doneLater == 3) && (timer.read_ms() < 500);
+    }
+    ok = mdm.socketFree(socket) && ok;
+    if (!ok) {
+      printf("modem: blocking read failed\n");
+      failed ++;
+    }
+    // small writes gathered in a send buffer, written once after the delay
+    static const char* const parts[] = { "GET / HTTP/1.0\r\n", "Host: example.com\r\n", "\r\n" };
+    static Pipe<char, 256> tx;
+    socket = mdm.socketSocket(MDMParser::IPPROTO_TCP);
+    ok = (socket != SOCKET_ERROR) &&
+         mdm.socketConnect(socket, "10.0.0.1", 7) &&
+         mdm.socketCoalesce(socket, &tx, 0, 20);
+    if (ok) {
+      // the delay runs across the wrap of the us ticker
+      hostTicker(0xFFFFFFFF - 5000);
+      n = device->commands();
+      int r = device->received();
+      int len = 0;
+      for (int i = 0; ok && (i < 3); i ++) {
+        int l = strlen(parts[i]);
+        ok = (mdm.socketSend(socket, parts[i], l) == l);
+        len += l;
+      }
+      Timer timer;
+      timer.start();
+      while ((device->received() - r < len) && (timer.read_ms() < 1000))
+        Thread::wait(1);
+      printf("modem: %d sends written with %d commands after %d us\n", 3,
+             device->commands() - n, timer.read_us());
+      ok = ok && (device->commands() - n == 1) && (device->received() - r == len) &&
+           (timer.read_ms() < 500) && (mdm.socketSend(socket, parts[2], 2) == 2) && (mdm.socketFlush(socket) == 2) &&
+           (device->commands() - n == 2);
+    }
+    ok = mdm.socketFree(socket) && ok;
+    if (!ok) {
+      printf("modem: coalesce failed\n");
+      failed ++;
+    }
+    // a failed write of a full buffer, only the data queued is reported
+    static Pipe<char, 16> small;
+    socket = mdm.socketSocket(MDMParser::IPPROTO_TCP);
+    ok = (socket != SOCKET_ERROR) &&
+         mdm.socketConnect(socket, "10.0.0.1", 7) &&
+         mdm.socketCoalesce(socket, &small);
+    if (ok) {
+      int r1 = mdm.socketSend(socket, payload, 20);
+      int r2 = mdm.socketSend(socket, payload, 4);
+      printf("modem: sends with a failing write queued %d and %d bytes\n", r1, r2);
+      ok = (r1 == 16) && (r2 == SOCKET_ERROR) && (small.size() == 16);
+    }
+    ok = mdm.socketFree(socket) && ok;
+    if (!ok) {
+      printf("modem: failing write misreported\n");
+      failed ++;
+    }
+    // a datagram from fragments, summed up in the command header
+    udp = mdm.socketSocket(MDMParser::IPPROTO_UDP);
+    ok = (udp != SOCKET_ERROR);
+    if (ok) {
+      MDMParser::SocketVec vec[3];
+      int len = 0;
+      for (int i = 0; i < 3; i ++) {
+        vec[i].buf = parts[i];
+        vec[i].len = strlen(parts[i]);
+        len += vec[i].len;
+      }
+      n = device->commands();
+      int r = device->received();
+      ok = (mdm.socketSendToVec(udp, mdm.gethostbyname("10.0.0.1"), 7, vec, 3) == len) &&
+           (device->commands() - n == 1) && (device->received() - r == len);
+      printf("modem: %d fragments written with %d commands\n", 3, device->commands() - n);
+    }
+    ok = mdm.socketFree(udp) && ok;
+    if (!ok) {
+      printf("modem: vector send failed\n");
+      failed ++;
+    }
+    // a burst of datagrams under one lock, a bad one rejects the whole batch
+    udp = mdm.socketSocket(MDMParser::IPPROTO_UDP);
+    ok = (udp != SOCKET_ERROR);
+    if (ok) {
+      MDMParser::IP ip = mdm.gethostbyname("10.0.0.1");
+      MDMParser::SocketDatagram dgrams[] = { { ip, 7, parts[0], (int)strlen(parts[0]), 0 },
+                                             { ip, 7, parts[1], (int)strlen(parts[1]), 0 },
+                                             { ip, 7, parts[2], (int)strlen(parts[2]), 0 },
+                                             { NOIP, 7, parts[0], (int)strlen(parts[0]), 0 } };
+      n = device->commands();
+      int r = device->received();
+      ok = (mdm.socketSendToBatch(udp, dgrams, 4) == SOCKET_ERROR);
+      dgrams[3].ip = ip;
+      dgrams[3].len = 0;
+      ok = (mdm.socketSendToBatch(udp, dgrams, 4) == SOCKET_ERROR) && ok;
+      ok = ok && (dgrams[0].result == SOCKET_ERROR) && (device->commands() - n == 0);
+      Timer timer;
+      timer.start();
+      int sent = mdm.socketSendToBatch(udp, dgrams, 3);
+      printf("modem: %d of %d datagrams written in %d us\n", sent, 3, timer.read_us());
+      ok = ok && (sent == 3) && (dgrams[2].result == dgrams[2].len) &&
+           (device->commands() - n == 3) &&
+           (device->received() - r == dgrams[0].len + dgrams[1].len + dgrams[2].len);
+    }
+    ok = mdm.socketFree(udp) && ok;
+    if (!ok) {
+      printf("modem: batch send failed\n");
+      failed ++;
+    }
+  }
+  SerialPipe::Stats st;
+  if (mdm.stats(&st))
+    printStats("modem", &st);
+  if (level >= 1) {
+    mdm.dumpDevStatus(&devStatus);
+    mdm.dumpNetStatus(&netStatus);
+  }
+
+  // dma receive with a fake backend, a lap of the buffer passes unseen
+  {
+    static char data[64 + 10];
+    SerialPipe port(PB_6, PB_7, 64, 16);
+    SerialDmaFake dma;
+    bool ok = port.rxDma(&dma);
+    dma.receive(data, sizeof(data), false);
+    dma.idle();
+    ok = ok && (port.get(data, sizeof(data), false) == 10);
+    // a whole buffer that was not published yet is complete
+    dma.receive(data, 64, false);
+    dma.idle();
+    ok = ok && (port.get(data, sizeof(data), false) == 64);
+    if (ok && port.stats(&st))
+      ok = (st.rx.dropped == 64);
+    if (!ok) {
+      printf("dma: laps of the buffer not handled\n");
+      failed ++;
+    }
+  }
+
+  // the gps, a device or a replayed log
+  if (gpsPath) {
+    int gfd = hostOpen(gpsPath);
+    if (gfd < 0) {
+      perror(gpsPath);
+      return 1;
+    }
+    hostI2C(D14, gfd);
+    static GPSI2CStatic<256> gps;
+    if (!gps.init())
+      printf("gps: init failed\n");
+    static GPSTracker tracker(gps);
+    GPSTracker::Position pos;
+    Timer timer;
+    timer.start();
+    while (!tracker.position(&pos) && (timer.read_ms() < 5000))
+      Thread::wait(10);
+    if (timer.read_ms() < 5000)
+      printf("gps: %.6f %.6f %.1f m after %d ms\n", pos.latitude, pos.longitude,
+             pos.altitude, timer.read_ms());
+    else {
+      printf("gps: no position\n");
+      failed ++;
+    }
+  }
+  return failed ? 1 : 0;
+}
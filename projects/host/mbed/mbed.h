@@ -0,0 +1,295 @@
+#pragma once
+
+/** Host (Linux) replacement of the parts of the mbed library used by the
+ *  discovery components. Serial ports and I2C devices are backed by file
+ *  descriptors (pty, tty, socketpair or file) which are mapped to pins
+ *  with #hostSerial and #hostI2C, a thread per port stands in for the
+ *  interrupts. Use it to run the parsers on a PC.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <functional>
+
+#define TARGET_HOST
+#define DEVICE_SERIAL_FC 1
+
+typedef enum {
+  PA_0, PA_1, PA_2, PA_3, PA_4, PA_5, PA_6, PA_7, PA_8, PA_9, PA_10, PA_11, PA_12, PA_13, PA_14, PA_15,
+  PB_0, PB_1, PB_2, PB_3, PB_4, PB_5, PB_6, PB_7, PB_8, PB_9, PB_10, PB_11, PB_12, PB_13, PB_14, PB_15,
+  D0, D1, D2, D3, D4, D5, D6, D7, D8, D9, D10, D11, D12, D13, D14, D15,
+  LED1, LED2, LED3, LED4, USER_BUTTON,
+  USBTX, USBRX,
+  NC = -1
+} PinName;
+
+// host specific
+//----------------------------------------------------
+
+/** Set the microsecond ticker (us_ticker_read), e.g. to just before its
+ *  wrap, it keeps running from there
+ *  \param us the new ticker value
+ */
+void hostTicker(uint32_t us);
+
+/** Back the serial port that uses a pin with a file descriptor
+ *  \param pin the tx or rx pin of the serial port
+ *  \param fd the file descriptor, -1 to remove the mapping
+ */
+void hostSerial(PinName pin, int fd);
+
+/** Back the I2C device that uses a pin with a file descriptor, it behaves
+ *  like the DDC interface of a u-blox gps (length and stream register).
+ *  \param pin the sda pin of the I2C bus
+ *  \param fd the file descriptor, -1 to remove the mapping
+ */
+void hostI2C(PinName pin, int fd);
+
+/** Open a device (pty, tty or file) and configure a tty to raw mode
+ *  \param path the path of the device
+ *  \return the file descriptor or -1 on error
+ */
+int hostOpen(const char* path);
+
+// interrupts
+//----------------------------------------------------
+
+//! enter the critical section shared with all interrupt threads
+void __disable_irq(void);
+//! leave the critical section
+void __enable_irq(void);
+
+// wait
+//----------------------------------------------------
+
+void wait(float s);
+void wait_ms(int ms);
+void wait_us(int us);
+
+// Timer
+//----------------------------------------------------
+
+class Timer
+{
+public:
+  Timer(void);
+  void start(void);
+  void stop(void);
+  void reset(void);
+  float read(void);
+  int read_ms(void);
+  int read_us(void);
+  operator float(void) { return read(); }
+protected:
+  long long _now(void);
+  long long _start; //!< start of the running period (us)
+  long long _time;  //!< accumulated time of the stopped periods (us)
+  bool      _run;   //!< the timer is running
+};
+
+// Ticker
+//----------------------------------------------------
+
+/** Periodic interrupt, a thread calls the handler with the interrupt lock
+ *  held once the microsecond ticker passed the due time, so it follows
+ *  the jumps of #hostTicker.
+ */
+class Ticker
+{
+public:
+  Ticker(void);
+  ~Ticker(void);
+  void attach(void (*fptr)(void), float t) { attach_us(fptr, (uint32_t)(t * 1000000.0f)); }
+  template<typename T>
+  void attach(T* tptr, void (T::*mptr)(void), float t)
+  {
+    attach_us(tptr, mptr, (uint32_t)(t * 1000000.0f));
+  }
+  void attach_us(void (*fptr)(void), uint32_t t) { _attach(std::function<void(void)>(fptr), t); }
+  template<typename T>
+  void attach_us(T* tptr, void (T::*mptr)(void), uint32_t t)
+  {
+    _attach(std::bind(mptr, tptr), t);
+  }
+  void detach(void) { _attach(std::function<void(void)>(), 0); }
+protected:
+  //! set the handler and the period, taking the interrupt lock
+  void _attach(std::function<void(void)> fn, uint32_t t);
+  //! the thread standing in for the interrupt
+  static void* _irqThread(void* param);
+  volatile bool             _run;    //!< the interrupt thread runs
+  pthread_t                 _thread; //!< the interrupt thread
+  std::function<void(void)> _fn;     //!< the handler
+  uint32_t                  _period; //!< the period (us)
+  uint32_t                  _due;    //!< ticker value the handler is due at
+};
+
+// gpio
+//----------------------------------------------------
+
+typedef struct {
+  PinName pin;
+  int     value;
+} gpio_t;
+
+void gpio_init_out(gpio_t* obj, PinName pin);
+void gpio_write(gpio_t* obj, int value);
+
+class DigitalOut
+{
+public:
+  DigitalOut(PinName pin, int value = 0) { _value = value; }
+  void write(int value) { _value = value; }
+  int read(void) { return _value; }
+  DigitalOut& operator= (int value) { write(value); return *this; }
+  operator int() { return read(); }
+protected:
+  int _value; //!< the output level
+};
+
+class DigitalIn
+{
+public:
+  DigitalIn(PinName pin) { }
+  int read(void) { return 0; }
+  operator int() { return read(); }
+};
+
+class DigitalInOut
+{
+public:
+  DigitalInOut(PinName pin) { _value = 0; }
+  void write(int value) { _value = value; }
+  int read(void) { return _value; }
+  void output(void) { }
+  void input(void) { }
+  DigitalInOut& operator= (int value) { write(value); return *this; }
+  operator int() { return read(); }
+protected:
+  int _value; //!< the output level
+};
+
+class InterruptIn
+{
+public:
+  InterruptIn(PinName pin) { }
+  void rise(void (*fptr)(void)) { }
+  void fall(void (*fptr)(void)) { }
+  template<typename T> void rise(T* tptr, void (T::*mptr)(void)) { }
+  template<typename T> void fall(T* tptr, void (T::*mptr)(void)) { }
+};
+
+class PwmOut
+{
+public:
+  PwmOut(PinName pin) { _value = 0; }
+  void period(float s) { }
+  void period_ms(int ms) { }
+  void write(float value) { _value = value; }
+  float read(void) { return _value; }
+  PwmOut& operator= (float value) { write(value); return *this; }
+  operator float() { return read(); }
+protected:
+  float _value; //!< the duty cycle
+};
+
+// Stream
+//----------------------------------------------------
+
+class Stream
+{
+public:
+  Stream(const char* name = NULL) { }
+  virtual ~Stream(void) { }
+  int putc(int c) { return _putc(c); }
+  int getc(void) { return _getc(); }
+  int puts(const char* s);
+  int printf(const char* format, ...);
+protected:
+  virtual int _getc(void) = 0;
+  virtual int _putc(int c) = 0;
+};
+
+// Serial
+//----------------------------------------------------
+
+/** Serial port backed by the file descriptor mapped to its pins. A
+ *  thread per port calls the rx handler while data is available and the
+ *  tx handler while it is attached (the transmitter is always ready).
+ */
+class SerialBase
+{
+public:
+  enum Parity { None = 0, Odd, Even, Forced1, Forced0 };
+  enum IrqType { RxIrq = 0, TxIrq };
+  enum Flow { Disabled = 0, RTS, CTS, RTSCTS };
+
+  SerialBase(PinName tx, PinName rx);
+  virtual ~SerialBase(void);
+
+  void baud(int baudrate) { }
+  void format(int bits = 8, Parity parity = None, int stop_bits = 1) { }
+  int readable(void);
+  int writeable(void);
+  void attach(void (*fptr)(void), IrqType type = RxIrq);
+  template<typename T>
+  void attach(T* tptr, void (T::*mptr)(void), IrqType type = RxIrq)
+  {
+    if (tptr && mptr)
+      _attach(std::bind(mptr, tptr), type);
+    else
+      _attach(std::function<void(void)>(), type);
+  }
+  void send_break(void) { }
+  void set_flow_control(Flow type, PinName flow1 = NC, PinName flow2 = NC) { }
+
+protected:
+  int _base_getc(void);
+  int _base_putc(int c);
+  //! set a handler, taking the interrupt lock
+  void _attach(std::function<void(void)> fn, IrqType type);
+  //! the thread standing in for the interrupt
+  static void* _irqThread(void* param);
+  //! read available data into the receive register
+  bool _fill(bool wait);
+  int                       _fd;      //!< the file descriptor
+  volatile bool             _run;     //!< the interrupt thread runs
+  pthread_t                 _thread;  //!< the interrupt thread
+  std::function<void(void)> _irq[2];  //!< the rx and tx handlers
+  unsigned char             _rx[64];  //!< receive register (like a fifo)
+  int                       _rxLen;   //!< bytes in the receive register
+  int                       _rxOfs;   //!< bytes consumed of the receive register
+};
+
+class Serial : public SerialBase, public Stream
+{
+public:
+  Serial(PinName tx, PinName rx, const char* name = NULL) :
+    SerialBase(tx, rx), Stream(name) { }
+protected:
+  virtual int _getc(void) { return _base_getc(); }
+  virtual int _putc(int c) { return _base_putc(c); }
+};
+
+// I2C
+//----------------------------------------------------
+
+/** I2C bus backed by the file descriptor mapped to its sda pin, it
+ *  emulates the DDC interface of a u-blox gps: register 0xFD returns
+ *  the number of bytes available, register 0xFF streams the data.
+ */
+class I2C
+{
+public:
+  I2C(PinName sda, PinName scl);
+  void frequency(int hz) { }
+  int read(int address, char* data, int length, bool repeated = false);
+  int write(int address, const char* data, int length, bool repeated = false);
+  void stop(void) { }
+protected:
+  int           _fd;  //!< the file descriptor
+  unsigned char _reg; //!< the selected register
+};
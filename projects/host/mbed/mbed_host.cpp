@@ -0,0 +1,582 @@
+#include "mbed.h"
+#include "rtos.h"
+#include "us_ticker_api.h"
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#define PINS  (USBRX + 1) //!< number of pins that can be mapped
+
+//! file descriptors mapped to pins
+class PinMap
+{
+public:
+  PinMap(void) { memset(_fd, -1, sizeof(_fd)); }
+  void set(PinName pin, int fd) { if ((pin >= 0) && (pin < PINS)) _fd[pin] = fd; }
+  int get(PinName pin) { return ((pin >= 0) && (pin < PINS)) ? _fd[pin] : -1; }
+protected:
+  int _fd[PINS]; //!< the file descriptor of each pin, -1 if not mapped
+};
+
+static PinMap _serialFd; //!< serial ports
+static PinMap _i2cFd;    //!< i2c devices
+
+//! the interrupt lock, shared by all interrupt threads
+static pthread_mutex_t _irqLock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+//! the offset of the microsecond ticker, see hostTicker
+static long long _ticker = 0;
+
+//! time since an arbitrary point in us
+static long long _monotonic(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// host specific
+//----------------------------------------------------
+
+void hostTicker(uint32_t us)
+{
+  _ticker = (long long)us - _monotonic();
+}
+
+void hostSerial(PinName pin, int fd)
+{
+  _serialFd.set(pin, fd);
+}
+
+void hostI2C(PinName pin, int fd)
+{
+  _i2cFd.set(pin, fd);
+}
+
+int hostOpen(const char* path)
+{
+  int fd = open(path, O_RDWR | O_NOCTTY);
+  if ((fd < 0) && (errno == EACCES || errno == EISDIR))
+    fd = open(path, O_RDONLY);
+  if (fd >= 0 && isatty(fd)) {
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+      cfmakeraw(&tio);
+      tcsetattr(fd, TCSANOW, &tio);
+    }
+  }
+  return fd;
+}
+
+// interrupts
+//----------------------------------------------------
+
+void __disable_irq(void)
+{
+  pthread_mutex_lock(&_irqLock);
+}
+
+void __enable_irq(void)
+{
+  pthread_mutex_unlock(&_irqLock);
+}
+
+// wait
+//----------------------------------------------------
+
+void wait(float s)
+{
+  wait_us((int)(s * 1000000.0f));
+}
+
+void wait_ms(int ms)
+{
+  wait_us(ms * 1000);
+}
+
+void wait_us(int us)
+{
+  struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+  while (nanosleep(&ts, &ts) && (errno == EINTR))
+    /* nothing / just wait */;
+}
+
+// ticker
+//----------------------------------------------------
+
+uint32_t us_ticker_read(void)
+{
+  return (uint32_t)(_monotonic() + _ticker);
+}
+
+// Timer
+//----------------------------------------------------
+
+Timer::Timer(void)
+{
+  _start = 0;
+  _time = 0;
+  _run = false;
+}
+
+long long Timer::_now(void)
+{
+  return _time + (_run ? _monotonic() - _start : 0);
+}
+
+void Timer::start(void)
+{
+  if (!_run) {
+    _start = _monotonic();
+    _run = true;
+  }
+}
+
+void Timer::stop(void)
+{
+  _time = _now();
+  _run = false;
+}
+
+void Timer::reset(void)
+{
+  _start = _monotonic();
+  _time = 0;
+}
+
+float Timer::read(void)
+{
+  return (float)_now() / 1000000.0f;
+}
+
+int Timer::read_ms(void)
+{
+  return (int)(_now() / 1000);
+}
+
+int Timer::read_us(void)
+{
+  return (int)_now();
+}
+
+// Ticker
+//----------------------------------------------------
+
+Ticker::Ticker(void)
+{
+  _period = 0;
+  _due = 0;
+  _run = true;
+  pthread_create(&_thread, NULL, _irqThread, this);
+}
+
+Ticker::~Ticker(void)
+{
+  _run = false;
+  pthread_join(_thread, NULL);
+}
+
+void Ticker::_attach(std::function<void(void)> fn, uint32_t t)
+{
+  __disable_irq();
+  _fn = fn;
+  _period = t;
+  _due = us_ticker_read() + t;
+  __enable_irq();
+}
+
+void* Ticker::_irqThread(void* param)
+{
+  Ticker* that = (Ticker*)param;
+  while (that->_run) {
+    __disable_irq();
+    if (that->_fn && ((int32_t)(us_ticker_read() - that->_due) >= 0)) {
+      // a jump of the ticker calls the handler once, like a late interrupt
+      that->_due = us_ticker_read() + that->_period;
+      that->_fn();
+    }
+    __enable_irq();
+    wait_us(1000);
+  }
+  return NULL;
+}
+
+// gpio
+//----------------------------------------------------
+
+void gpio_init_out(gpio_t* obj, PinName pin)
+{
+  obj->pin = pin;
+  obj->value = 0;
+}
+
+void gpio_write(gpio_t* obj, int value)
+{
+  obj->value = value;
+}
+
+// Stream
+//----------------------------------------------------
+
+int Stream::puts(const char* s)
+{
+  int n = 0;
+  while (*s) {
+    _putc(*s++);
+    n ++;
+  }
+  return n;
+}
+
+int Stream::printf(const char* format, ...)
+{
+  char buf[256];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (n >= (int)sizeof(buf))
+    n = sizeof(buf) - 1;
+  for (int i = 0; i < n; i ++)
+    _putc(buf[i]);
+  return n;
+}
+
+// Serial
+//----------------------------------------------------
+
+SerialBase::SerialBase(PinName tx, PinName rx)
+{
+  _fd = _serialFd.get(tx);
+  if (_fd < 0)
+    _fd = _serialFd.get(rx);
+  _rxLen = 0;
+  _rxOfs = 0;
+  _run = true;
+  pthread_create(&_thread, NULL, _irqThread, this);
+}
+
+SerialBase::~SerialBase(void)
+{
+  _run = false;
+  pthread_join(_thread, NULL);
+}
+
+bool SerialBase::_fill(bool wait)
+{
+  if (_rxOfs < _rxLen)
+    return true;
+  if (_fd < 0)
+    return false;
+  struct pollfd pfd = { _fd, POLLIN, 0 };
+  if (poll(&pfd, 1, wait ? 10 : 0) <= 0)
+    return false;
+  if (!(pfd.revents & POLLIN))
+    return false;
+  int n = ::read(_fd, _rx, sizeof(_rx));
+  if (n <= 0)
+    return false;
+  _rxOfs = 0;
+  _rxLen = n;
+  return true;
+}
+
+int SerialBase::readable(void)
+{
+  return _fill(false);
+}
+
+int SerialBase::writeable(void)
+{
+  return 1;
+}
+
+int SerialBase::_base_getc(void)
+{
+  while (!_fill(true)) {
+    if (_fd < 0)
+      return EOF;
+  }
+  return _rx[_rxOfs ++];
+}
+
+int SerialBase::_base_putc(int c)
+{
+  unsigned char ch = c;
+  while ((_fd >= 0) && (::write(_fd, &ch, 1) < 0) && (errno == EINTR || errno == EAGAIN))
+    /* nothing / just retry */;
+  return c;
+}
+
+void SerialBase::attach(void (*fptr)(void), IrqType type)
+{
+  if (fptr)
+    _attach(std::function<void(void)>(fptr), type);
+  else
+    _attach(std::function<void(void)>(), type);
+}
+
+void SerialBase::_attach(std::function<void(void)> fn, IrqType type)
+{
+  __disable_irq();
+  _irq[type] = fn;
+  __enable_irq();
+}
+
+void* SerialBase::_irqThread(void* param)
+{
+  SerialBase* that = (SerialBase*)param;
+  while (that->_run) {
+    bool busy = false;
+    // wait for data if nothing else to do, handlers run with the lock held
+    bool rx = that->_fill(!that->_irq[TxIrq]);
+    __disable_irq();
+    if (rx && that->_irq[RxIrq]) {
+      that->_irq[RxIrq]();
+      busy = true;
+    }
+    if (that->_irq[TxIrq]) {
+      that->_irq[TxIrq]();
+      busy = true;
+    }
+    __enable_irq();
+    if (!busy)
+      wait_us(rx ? 1000 : 100);
+  }
+  return NULL;
+}
+
+// I2C
+//----------------------------------------------------
+
+I2C::I2C(PinName sda, PinName scl)
+{
+  _fd = _i2cFd.get(sda);
+  _reg = 0xFF;
+}
+
+int I2C::read(int address, char* data, int length, bool repeated)
+{
+  if (_fd < 0)
+    return 1; // nack
+  if (_reg == 0xFD) {
+    // length register, big endian
+    int avail = 0;
+    if (ioctl(_fd, FIONREAD, &avail) < 0)
+      avail = 0;
+    if (avail > 0xFFFF)
+      avail = 0xFFFF;
+    if (length > 0) data[0] = (char)(avail >> 8);
+    if (length > 1) data[1] = (char)(avail);
+    return 0;
+  }
+  // stream register
+  int n = 0;
+  while (n < length) {
+    int r = ::read(_fd, data + n, length - n);
+    if (r <= 0)
+      return 1;
+    n += r;
+  }
+  return 0;
+}
+
+int I2C::write(int address, const char* data, int length, bool repeated)
+{
+  if (_fd < 0)
+    return 1; // nack
+  if (length == 1 && ((unsigned char)*data == 0xFD || (unsigned char)*data == 0xFF)) {
+    _reg = *data;
+    return 0;
+  }
+  int n = 0;
+  while (n < length) {
+    int w = ::write(_fd, data + n, length - n);
+    if (w < 0)
+      return 1; // nack, e.g. a read only replay
+    n += w;
+  }
+  return 0;
+}
+
+// rtos
+//----------------------------------------------------
+
+struct os_thread_cb {
+  pthread_mutex_t mtx;     //!< protects the signals
+  pthread_cond_t  cond;    //!< signalled when the signals change
+  int32_t         signals; //!< the signal flags
+};
+
+static __thread osThreadId _self; //!< control block of the calling thread
+
+static osThreadId _threadCreate(void)
+{
+  osThreadId tid = new os_thread_cb;
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_mutex_init(&tid->mtx, NULL);
+  pthread_cond_init(&tid->cond, &attr);
+  pthread_condattr_destroy(&attr);
+  tid->signals = 0;
+  return tid;
+}
+
+osThreadId osThreadGetId(void)
+{
+  if (!_self)
+    _self = _threadCreate();
+  return _self;
+}
+
+int32_t osSignalSet(osThreadId thread_id, int32_t signals)
+{
+  if (!thread_id)
+    return 0x80000000;
+  pthread_mutex_lock(&thread_id->mtx);
+  int32_t old = thread_id->signals;
+  thread_id->signals |= signals;
+  pthread_cond_broadcast(&thread_id->cond);
+  pthread_mutex_unlock(&thread_id->mtx);
+  return old;
+}
+
+int32_t osSignalClear(osThreadId thread_id, int32_t signals)
+{
+  if (!thread_id)
+    return 0x80000000;
+  pthread_mutex_lock(&thread_id->mtx);
+  int32_t old = thread_id->signals;
+  thread_id->signals &= ~signals;
+  pthread_mutex_unlock(&thread_id->mtx);
+  return old;
+}
+
+Thread::Thread(void (*task)(void const* argument), void* argument,
+               osPriority priority, uint32_t stack_size, unsigned char* stack_pointer)
+{
+  _task = task;
+  _argument = argument;
+  _tid = _threadCreate();
+  pthread_create(&_thread, NULL, _entry, this);
+}
+
+Thread::~Thread(void)
+{
+  pthread_cancel(_thread);
+  pthread_detach(_thread);
+}
+
+void* Thread::_entry(void* param)
+{
+  Thread* that = (Thread*)param;
+  _self = that->_tid;
+  that->_task(that->_argument);
+  return NULL;
+}
+
+//! cancellation cleanup, unlock a mutex
+static void _unlock(void* mtx)
+{
+  pthread_mutex_unlock((pthread_mutex_t*)mtx);
+}
+
+osEvent Thread::signal_wait(int32_t signals, uint32_t millisec)
+{
+  osThreadId tid = osThreadGetId();
+  osEvent evt;
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  if (millisec != osWaitForever) {
+    ts.tv_sec  += millisec / 1000;
+    ts.tv_nsec += (millisec % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+      ts.tv_sec ++;
+      ts.tv_nsec -= 1000000000;
+    }
+  }
+  pthread_mutex_lock(&tid->mtx);
+  // a thread cancelled while waiting holds the mutex again, release it
+  pthread_cleanup_push(_unlock, &tid->mtx);
+  for (;;) {
+    int32_t got = signals ? (tid->signals & signals) : tid->signals;
+    if (signals ? (got == signals) : (got != 0)) {
+      tid->signals &= ~got;
+      evt.status = osEventSignal;
+      evt.value.signals = got;
+      break;
+    }
+    if (millisec == 0) {
+      evt.status = osOK;
+      break;
+    }
+    if (millisec == osWaitForever)
+      pthread_cond_wait(&tid->cond, &tid->mtx);
+    else if (pthread_cond_timedwait(&tid->cond, &tid->mtx, &ts) == ETIMEDOUT) {
+      evt.status = osEventTimeout;
+      break;
+    }
+  }
+  pthread_cleanup_pop(1);
+  return evt;
+}
+
+osStatus Thread::wait(uint32_t millisec)
+{
+  wait_ms(millisec);
+  return osEventTimeout;
+}
+
+osStatus Thread::yield(void)
+{
+  sched_yield();
+  return osOK;
+}
+
+Mutex::Mutex(void)
+{
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&_mtx, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+
+Mutex::~Mutex(void)
+{
+  pthread_mutex_destroy(&_mtx);
+}
+
+osStatus Mutex::lock(uint32_t millisec)
+{
+  if (millisec == osWaitForever)
+    return pthread_mutex_lock(&_mtx) ? osErrorResource : osOK;
+  if (millisec == 0)
+    return trylock() ? osOK : osErrorResource;
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_sec  += millisec / 1000;
+  ts.tv_nsec += (millisec % 1000) * 1000000;
+  if (ts.tv_nsec >= 1000000000) {
+    ts.tv_sec ++;
+    ts.tv_nsec -= 1000000000;
+  }
+  return pthread_mutex_timedlock(&_mtx, &ts) ? osErrorTimeoutResource : osOK;
+}
+
+bool Mutex::trylock(void)
+{
+  return pthread_mutex_trylock(&_mtx) == 0;
+}
+
+osStatus Mutex::unlock(void)
+{
+  return pthread_mutex_unlock(&_mtx) ? osErrorResource : osOK;
+}
@@ -0,0 +1,90 @@
+#ifndef RTOS_H
+#define RTOS_H
+
+/** Host (Linux) replacement of the parts of the mbed rtos used by the
+ *  discovery components, threads are pthreads. The priority and the
+ *  stack passed to a thread are ignored.
+ */
+
+#include "mbed.h"
+
+#define osWaitForever       0xFFFFFFFF  //!< wait forever timeout value
+#define DEFAULT_STACK_SIZE  2048        //!< only used for the size of stacks in objects
+
+typedef enum {
+  osPriorityIdle          = -3,
+  osPriorityLow           = -2,
+  osPriorityBelowNormal   = -1,
+  osPriorityNormal        =  0,
+  osPriorityAboveNormal   = +1,
+  osPriorityHigh          = +2,
+  osPriorityRealtime      = +3,
+  osPriorityError         = 0x84
+} osPriority;
+
+typedef enum {
+  osOK                    = 0,
+  osEventSignal           = 0x08,
+  osEventMessage          = 0x10,
+  osEventMail             = 0x20,
+  osEventTimeout          = 0x40,
+  osErrorParameter        = 0x80,
+  osErrorResource         = 0x81,
+  osErrorTimeoutResource  = 0xC1,
+  osErrorValue            = 0x86,
+  osErrorOS               = 0xFF
+} osStatus;
+
+typedef struct {
+  osStatus status;
+  union {
+    uint32_t v;
+    void*    p;
+    int32_t  signals;
+  } value;
+} osEvent;
+
+//! the control block of a thread (signal flags)
+typedef struct os_thread_cb* osThreadId;
+
+osThreadId osThreadGetId(void);
+int32_t osSignalSet(osThreadId thread_id, int32_t signals);
+int32_t osSignalClear(osThreadId thread_id, int32_t signals);
+
+class Thread
+{
+public:
+  Thread(void (*task)(void const* argument), void* argument = NULL,
+         osPriority priority = osPriorityNormal,
+         uint32_t stack_size = DEFAULT_STACK_SIZE,
+         unsigned char* stack_pointer = NULL);
+  ~Thread(void);
+  int32_t signal_set(int32_t signals) { return osSignalSet(_tid, signals); }
+  osStatus set_priority(osPriority priority) { return osOK; }
+  osPriority get_priority(void) { return osPriorityNormal; }
+  static osEvent signal_wait(int32_t signals, uint32_t millisec = osWaitForever);
+  static osStatus wait(uint32_t millisec);
+  static osStatus yield(void);
+  static osThreadId gettid(void) { return osThreadGetId(); }
+protected:
+  //! pthread entry
+  static void* _entry(void* param);
+  void (*_task)(void const* argument); //!< the task function
+  void*      _argument; //!< the task argument
+  osThreadId _tid;      //!< the control block
+  pthread_t  _thread;   //!< the pthread
+};
+
+class Mutex
+{
+public:
+  Mutex(void);
+  ~Mutex(void);
+  osStatus lock(uint32_t millisec = osWaitForever);
+  bool trylock(void);
+  osStatus unlock(void);
+protected:
+  pthread_mutex_t _mtx; //!< recursive like a RTX mutex
+};
+
+#endif
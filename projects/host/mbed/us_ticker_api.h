@@ -0,0 +1,10 @@
+#pragma once
+
+/** Host (Linux) replacement of the mbed microsecond ticker, it can be set
+ *  with #hostTicker to cross its 32 bit wrap early.
+ */
+
+#include <stdint.h>
+
+//! the free running microsecond ticker, wraps at 32 bit
+uint32_t us_ticker_read(void);